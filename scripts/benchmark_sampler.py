@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# Compare the convergence (RMSE against a reference) of the available pixel samplers.
+# Usage: benchmark_sampler.py [-s max_spp] [-r reference_spp] [-a api_dir] scene.json
+
+import argparse
+import os
+import sys
+
+import numpy as np
+
+SAMPLERS = ["uniform", "mjitt", "sobol"]
+
+
+def create_runtime(scene, sampler):
+    opts = ignis.RuntimeOptions()
+    opts.OverridePixelSampler = sampler
+    opts.SPI = 1  # One sample per iteration to measure every power of two
+    runtime = ignis.Runtime(scene, opts)
+
+    settings = runtime.loadedRenderSettings
+    runtime.setup(settings.FilmWidth, settings.FilmHeight)
+    camera = ignis.Camera(settings.CameraEye, settings.CameraDir, settings.CameraUp,
+                          settings.FOV, settings.FilmWidth / settings.FilmHeight, settings.TMin, settings.TMax)
+    return runtime, camera
+
+
+def current_image(runtime):
+    return np.array(runtime.getFramebuffer(0)) / runtime.filmIterationCount
+
+
+def render_reference(scene, spp):
+    runtime, camera = create_runtime(scene, "uniform")
+    runtime.seedOffset = 0x80000000  # Independent from the measured renderings
+    for _ in range(spp):
+        runtime.step(camera)
+    return current_image(runtime)
+
+
+def measure(scene, sampler, max_spp, reference):
+    runtime, camera = create_runtime(scene, sampler)
+
+    errors = []
+    next_spp = 1
+    for spp in range(1, max_spp + 1):
+        runtime.step(camera)
+        if spp == next_spp:
+            errors.append(np.sqrt(np.mean((current_image(runtime) - reference) ** 2)))
+            next_spp *= 2
+    return errors
+
+
+if __name__ == "__main__":
+    script_dir = os.path.dirname(os.path.realpath(__file__))
+
+    parser = argparse.ArgumentParser(description="Benchmark the convergence of the pixel samplers")
+    parser.add_argument("scene", help="Scene file to render")
+    parser.add_argument("-s", "--spp", type=int, default=256, help="Maximum number of samples per pixel")
+    parser.add_argument("-r", "--reference", type=int, default=4096, help="Samples per pixel of the reference")
+    parser.add_argument("-a", "--api", default=os.path.join(script_dir, "../build/Release/api"),
+                        help="Directory containing the ignis python module")
+    args = parser.parse_args()
+
+    sys.path.append(args.api)
+    sys.path.append(os.path.join(script_dir, "../build/api"))
+    import ignis
+
+    reference = render_reference(args.scene, args.reference)
+    results = {sampler: measure(args.scene, sampler, args.spp, reference) for sampler in SAMPLERS}
+
+    print(f"{'spp':>6} " + " ".join(f"{sampler:>12}" for sampler in SAMPLERS))
+    for i in range(len(results[SAMPLERS[0]])):
+        print(f"{2 ** i:>6} " + " ".join(f"{results[sampler][i]:12.6f}" for sampler in SAMPLERS))
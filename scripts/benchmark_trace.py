@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# Compare the throughput of the list based trace API against the numpy based one.
+# Usage: benchmark_trace.py [-n rays] [-i iterations] [-a api_dir] scene.json
+
+import argparse
+import os
+import sys
+import time
+
+import numpy as np
+
+
+def make_rays(count, rng):
+    origins = rng.uniform(-1, 1, size=(count, 3)).astype(np.float32)
+    directions = rng.normal(size=(count, 3)).astype(np.float32)
+    directions /= np.linalg.norm(directions, axis=1, keepdims=True)
+    return origins, directions
+
+
+def measure(func, iterations):
+    func()  # Warm up
+    timings = []
+    for _ in range(iterations):
+        start = time.perf_counter()
+        func()
+        timings.append(time.perf_counter() - start)
+    return np.median(timings)
+
+
+if __name__ == "__main__":
+    script_dir = os.path.dirname(os.path.realpath(__file__))
+
+    parser = argparse.ArgumentParser(description="Benchmark the python trace API")
+    parser.add_argument("scene", help="Scene file to trace against")
+    parser.add_argument("-n", "--rays", type=int, default=1000000, help="Number of rays per call")
+    parser.add_argument("-i", "--iterations", type=int, default=5, help="Number of measured calls")
+    parser.add_argument("-a", "--api", default=os.path.join(script_dir, "../build/Release/api"),
+                        help="Directory containing the ignis python module")
+    args = parser.parse_args()
+
+    sys.path.append(args.api)
+    sys.path.append(os.path.join(script_dir, "../build/api"))
+    import ignis
+
+    opts = ignis.RuntimeOptions()
+    opts.OverrideCamera = "list"
+    runtime = ignis.Runtime(args.scene, opts)
+    runtime.setup(args.rays, 1)
+
+    origins, directions = make_rays(args.rays, np.random.default_rng(42))
+
+    def trace_list():
+        rays = [ignis.Ray(o, d, 0, np.finfo(np.float32).max) for o, d in zip(origins, directions)]
+        return runtime.trace(rays)
+
+    def trace_numpy():
+        return runtime.trace_numpy(origins, directions)
+
+    for name, func in [("list", trace_list), ("numpy", trace_numpy)]:
+        seconds = measure(func, args.iterations)
+        print(f"{name:>6}: {args.rays / seconds / 1e6:8.3f} Mrays/s ({seconds * 1000:.1f} ms per call)")
@@ -18,6 +18,7 @@
 
 #include <atomic>
 #include <cstring>
+#include <fstream>
 #include <iomanip>
 #include <mutex>
 #include <thread>
@@ -39,8 +40,11 @@ static inline size_t roundUp(size_t num, size_t multiple)
 // TODO: It would be great to get the number below automatically
 constexpr size_t MaxRayPayloadComponents = 8;
 constexpr size_t RayStreamSize           = 9;
-constexpr size_t PrimaryStreamSize       = RayStreamSize + 6 + MaxRayPayloadComponents;
+constexpr size_t PrimaryStreamSize       = RayStreamSize + 8 + MaxRayPayloadComponents;
 constexpr size_t SecondaryStreamSize     = RayStreamSize + 4;
+constexpr size_t RayListComponents       = 8;  // Has to be in sync with StreamRayList
+constexpr size_t CameraViewComponents    = 16; // Has to be in sync with RayGenerationShader
+constexpr size_t AdaptiveComponents      = 5;  // Has to be in sync with the adaptive sampler in mapping_cpu.art
 
 template <typename Node, typename Object>
 struct BvhProxy {
@@ -83,11 +87,15 @@ struct Interface {
         std::array<anydsl::Array<float>, GPUStreamBufferCount> secondary;
         std::vector<anydsl::Array<float>> aovs;
         anydsl::Array<float> film_pixels;
-        anydsl::Array<StreamRay> ray_list;
+        std::array<anydsl::Array<float>, RayListComponents> ray_list;
+        size_t ray_list_id = 0;
+        anydsl::Array<float> camera_views;
+        size_t camera_views_id = 0;
         std::array<anydsl::Array<float>*, GPUStreamBufferCount> current_primary;
         std::array<anydsl::Array<float>*, GPUStreamBufferCount> current_secondary;
         std::unordered_map<std::string, DeviceImage> images;
         std::unordered_map<std::string, DeviceBuffer> buffers;
+        std::unordered_map<std::string, DeviceBuffer> loaded_buffers;
 
         inline DeviceData()
             : scene_loaded(ATOMIC_FLAG_INIT)
@@ -120,7 +128,14 @@ struct Interface {
     IG::uint32 current_iteration;
     Settings current_settings;
 
-    const IG::Ray* ray_list = nullptr; // film_width contains number of rays
+    const IG::RayBatch* ray_list = nullptr; // film_width contains number of rays
+    size_t ray_list_id           = 0;       // Increased for every given list, used to track device copies
+
+    std::vector<float> camera_views;
+    size_t camera_views_id = 0; // Increased for every given set of views, used to track device copies
+
+    std::vector<float> adaptive_data; // Per pixel [weighted luminance sum, weighted squared luminance sum, sample weight, rendered iterations, luminance before the current iteration]
+    IG::uint32 film_iterations = 0;
 
     DriverSetupSettings setup;
     IG::TechniqueVariantShaderSet shader_set;
@@ -137,6 +152,9 @@ struct Interface {
     {
         for (auto& arr : aovs)
             arr = std::move(anydsl::Array<float>(film_width * film_height * 3));
+
+        if (setup.adaptive_error > 0)
+            adaptive_data.resize(film_width * film_height * AdaptiveComponents, 0.0f);
     }
 
     inline ~Interface()
@@ -166,8 +184,12 @@ struct Interface {
         thread_local CPUData* dataptr = nullptr;
         if (!dataptr) {
             thread_mutex.lock();
-            if (!thread_data.count(std::this_thread::get_id()))
-                thread_data[std::this_thread::get_id()] = std::make_unique<CPUData>();
+            if (!thread_data.count(std::this_thread::get_id())) {
+                auto data = std::make_unique<CPUData>();
+                if (setup.record_timeline)
+                    data->stats.enableTimeline((IG::uint32)thread_data.size());
+                thread_data[std::this_thread::get_id()] = std::move(data);
+            }
 
             dataptr = thread_data[std::this_thread::get_id()].get();
             thread_mutex.unlock();
@@ -260,41 +282,82 @@ struct Interface {
         return std::get<Bvh>(device.bvh_ent);
     }
 
-    inline const anydsl::Array<StreamRay>& loadRayList(int32_t dev)
+    inline void setRayList(const IG::RayBatch* rays)
     {
-        auto& device = devices[dev];
-        if (device.ray_list.size() != 0)
-            return device.ray_list;
+        // The count is taken from the batch directly, the float width of the render settings is not exact for large counts
+        const size_t count = rays->Count;
 
-        std::vector<StreamRay> rays;
-        rays.reserve(film_width);
+        ray_list = rays;
+        ++ray_list_id;
 
-        for (size_t i = 0; i < film_width; ++i) {
-            const IG::Ray dRay = ray_list[i];
+        // The framebuffer holds one entry per ray, grow it if necessary. Device copies are reallocated on demand
+        if (host_pixels.size() < (int64_t)(count * 3)) {
+            host_pixels = std::move(anydsl::Array<float>(count * 3));
+            for (auto& arr : aovs)
+                arr = std::move(anydsl::Array<float>(count * 3));
 
-            float norm = dRay.Direction.norm();
-            if (norm < std::numeric_limits<float>::epsilon()) {
-                std::cerr << "Invalid ray given: Ray has zero direction!" << std::endl;
-                norm = 1;
+            for (auto& pair : devices) {
+                pair.second.film_pixels = anydsl::Array<float>();
+                for (auto& arr : pair.second.aovs)
+                    arr = anydsl::Array<float>();
             }
+        }
 
-            // FIXME: Bytewise they are essentially the same...
-            StreamRay ray;
-            ray.org.x = dRay.Origin(0);
-            ray.org.y = dRay.Origin(1);
-            ray.org.z = dRay.Origin(2);
+        film_width  = count;
+        film_height = 1;
+    }
+
+    inline void loadRayList(int32_t dev, StreamRayList* list)
+    {
+        static_assert(std::is_pod<StreamRayList>::value, "Expected StreamRayList to be plain old data");
+        IG_ASSERT(ray_list != nullptr, "Expected a ray list to be given");
 
-            ray.dir.x = dRay.Direction(0) / norm;
-            ray.dir.y = dRay.Direction(1) / norm;
-            ray.dir.z = dRay.Direction(2) / norm;
+        const float* host[RayListComponents] = {
+            ray_list->OriginX, ray_list->OriginY, ray_list->OriginZ,
+            ray_list->DirectionX, ray_list->DirectionY, ray_list->DirectionZ,
+            ray_list->TMin, ray_list->TMax
+        };
 
-            ray.tmin = dRay.Range(0);
-            ray.tmax = dRay.Range(1);
+        float** l_ptr = reinterpret_cast<float**>(list);
+        if (dev == 0) {
+            // Host memory can be used directly
+            for (size_t i = 0; i < RayListComponents; ++i)
+                l_ptr[i] = const_cast<float*>(host[i]);
+            return;
+        }
 
-            rays.push_back(ray);
+        auto& device = devices[dev];
+        if (device.ray_list_id != ray_list_id) {
+            for (size_t i = 0; i < RayListComponents; ++i) {
+                auto& array = resizeArray(dev, device.ray_list[i], film_width, 1);
+                anydsl_copy(0, host[i], 0, dev, array.data(), 0, sizeof(float) * film_width);
+            }
+            device.ray_list_id = ray_list_id;
         }
 
-        return device.ray_list = std::move(copyToDevice(dev, rays));
+        for (size_t i = 0; i < RayListComponents; ++i)
+            l_ptr[i] = device.ray_list[i].data();
+    }
+
+    inline void setCameraViews(const float* views, size_t count)
+    {
+        camera_views.assign(views, views + count * CameraViewComponents);
+        ++camera_views_id;
+    }
+
+    inline const float* loadCameraViews(int32_t dev)
+    {
+        IG_ASSERT(!camera_views.empty(), "Expected camera views to be given");
+        if (dev == 0)
+            return camera_views.data();
+
+        auto& device = devices[dev];
+        if (device.camera_views_id != camera_views_id) {
+            auto& array = resizeArray(dev, device.camera_views, camera_views.size(), 1);
+            anydsl_copy(0, camera_views.data(), 0, dev, array.data(), 0, sizeof(float) * camera_views.size());
+            device.camera_views_id = camera_views_id;
+        }
+        return device.camera_views.data();
     }
 
     template <typename T>
@@ -400,9 +463,38 @@ struct Interface {
         }
 
         IG_LOG(IG::L_DEBUG) << "Requested buffer " << name << " with " << size << " bytes" << std::endl;
-        return buffers[name] = std::move(DeviceBuffer(
-                   std::move(anydsl::Array<uint8_t>(dev, reinterpret_cast<uint8_t*>(anydsl_alloc(dev, size)), size)),
-                   size));
+        auto& buffer = buffers[name] = std::move(DeviceBuffer(
+                           std::move(anydsl::Array<uint8_t>(dev, reinterpret_cast<uint8_t*>(anydsl_alloc(dev, size)), size)),
+                           size));
+
+        // Buffers are used to accumulate data across iterations, make sure they start cleared
+        std::vector<uint8_t> zeros(size, 0);
+        anydsl_copy(0, zeros.data(), 0, dev, std::get<0>(buffer).data(), 0, size);
+        return buffer;
+    }
+
+    inline const DeviceBuffer& loadBuffer(int32_t dev, const std::string& filename)
+    {
+        std::lock_guard<std::mutex> _guard(thread_mutex);
+
+        auto& buffers = devices[dev].loaded_buffers;
+        auto it       = buffers.find(filename);
+        if (it != buffers.end())
+            return it->second;
+
+        IG_LOG(IG::L_DEBUG) << "Loading buffer " << filename << std::endl;
+        std::ifstream stream(filename, std::ios::binary | std::ios::ate);
+        if (!stream)
+            IG_LOG(IG::L_ERROR) << "Could not load buffer " << filename << std::endl;
+
+        const int32_t file_size = stream ? (int32_t)stream.tellg() : 0;
+        std::vector<uint8_t> host(roundUp(std::max(file_size, 1), 32), 0);
+        if (file_size > 0) {
+            stream.seekg(0);
+            stream.read(reinterpret_cast<char*>(host.data()), file_size);
+        }
+
+        return buffers[filename] = std::move(DeviceBuffer(copyToDevice(dev, host), (int32_t)host.size()));
     }
 
     inline int runRayGenerationShader(int* id, int size, int xmin, int ymin, int xmax, int ymax)
@@ -416,7 +508,7 @@ struct Interface {
         const int ret = callback(&current_settings, current_iteration, id, size, xmin, ymin, xmax, ymax);
 
         if (setup.acquire_stats)
-            getThreadData()->stats.endShaderLaunch(IG::ShaderType::RayGeneration, {});
+            getThreadData()->stats.endShaderLaunch(IG::ShaderType::RayGeneration, {}, ret > size ? ret - size : 0);
         return ret;
     }
 
@@ -431,7 +523,7 @@ struct Interface {
         callback(&current_settings, first, last);
 
         if (setup.acquire_stats)
-            getThreadData()->stats.endShaderLaunch(IG::ShaderType::Miss, {});
+            getThreadData()->stats.endShaderLaunch(IG::ShaderType::Miss, {}, last - first);
     }
 
     inline void runHitShader(int entity_id, int first, int last)
@@ -447,7 +539,7 @@ struct Interface {
         callback(&current_settings, entity_id, first, last);
 
         if (setup.acquire_stats)
-            getThreadData()->stats.endShaderLaunch(IG::ShaderType::Hit, entity_id);
+            getThreadData()->stats.endShaderLaunch(IG::ShaderType::Hit, entity_id, last - first);
     }
 
     inline bool useAdvancedShadowHandling()
@@ -469,7 +561,7 @@ struct Interface {
             callback(&current_settings, first, last);
 
             if (setup.acquire_stats)
-                getThreadData()->stats.endShaderLaunch(IG::ShaderType::AdvancedShadowHit, {});
+                getThreadData()->stats.endShaderLaunch(IG::ShaderType::AdvancedShadowHit, {}, last - first);
         } else {
             if (setup.acquire_stats)
                 getThreadData()->stats.beginShaderLaunch(IG::ShaderType::AdvancedShadowMiss, {});
@@ -480,7 +572,7 @@ struct Interface {
             callback(&current_settings, first, last);
 
             if (setup.acquire_stats)
-                getThreadData()->stats.endShaderLaunch(IG::ShaderType::AdvancedShadowMiss, {});
+                getThreadData()->stats.endShaderLaunch(IG::ShaderType::AdvancedShadowMiss, {}, last - first);
         }
     }
 
@@ -489,7 +581,7 @@ struct Interface {
         if (dev != 0) {
             auto& device = devices[dev];
             if (!device.film_pixels.size()) {
-                auto film_size     = film_width * film_height * 3;
+                auto film_size     = host_pixels.size();
                 auto film_data     = reinterpret_cast<float*>(anydsl_alloc(dev, sizeof(float) * film_size));
                 device.film_pixels = std::move(anydsl::Array<float>(dev, film_data, film_size));
                 anydsl::copy(host_pixels, device.film_pixels);
@@ -512,7 +604,7 @@ struct Interface {
                 device.aovs.resize(aovs.size());
 
             if (!device.aovs[index].size()) {
-                auto film_size     = film_width * film_height * 3;
+                auto film_size     = aovs[index].size();
                 auto film_data     = reinterpret_cast<float*>(anydsl_alloc(dev, sizeof(float) * film_size));
                 device.aovs[index] = std::move(anydsl::Array<float>(dev, film_data, film_size));
                 anydsl::copy(aovs[index], device.aovs[index]);
@@ -536,6 +628,7 @@ struct Interface {
     {
         if (aov <= 0) {
             std::memset(host_pixels.data(), 0, sizeof(float) * host_pixels.size());
+            std::fill(adaptive_data.begin(), adaptive_data.end(), 0.0f);
             for (auto& pair : devices) {
                 auto& device_pixels = devices[pair.first].film_pixels;
                 if (device_pixels.size())
@@ -558,6 +651,35 @@ struct Interface {
         }
     }
 
+    /// Replace content of specific aov with the given data. Note, aov == 0 is the framebuffer
+    inline void set(int aov, const float* data)
+    {
+        if (aov <= 0) {
+            std::memcpy(host_pixels.data(), data, sizeof(float) * host_pixels.size());
+            std::fill(adaptive_data.begin(), adaptive_data.end(), 0.0f); // Statistics are not part of the given data
+            for (auto& pair : devices) {
+                auto& device_pixels = devices[pair.first].film_pixels;
+                if (device_pixels.size())
+                    anydsl::copy(host_pixels, device_pixels);
+            }
+            return;
+        }
+
+        const size_t id = aov - 1;
+        if (id >= aovs.size())
+            return;
+
+        auto& buffer = aovs[id];
+        std::memcpy(buffer.data(), data, sizeof(float) * buffer.size());
+        for (auto& pair : devices) {
+            if (devices[pair.first].aovs.empty())
+                continue;
+            auto& device_pixels = devices[pair.first].aovs[id];
+            if (device_pixels.size())
+                anydsl::copy(buffer, device_pixels);
+        }
+    }
+
     inline IG::Statistics* getFullStats()
     {
         main_stats.reset();
@@ -601,9 +723,13 @@ void glue_render(const DriverRenderSettings* settings, IG::uint32 iter)
 {
     Settings renderSettings = convert_settings(settings);
 
-    sInterface->ray_list          = settings->rays;
+    if (settings->rays)
+        sInterface->setRayList(settings->rays);
+    if (settings->camera_views)
+        sInterface->setCameraViews(settings->camera_views, settings->camera_count);
     sInterface->current_iteration = iter;
     sInterface->current_settings  = renderSettings;
+    sInterface->film_iterations   = settings->film_iterations;
 
     if (sInterface->setup.acquire_stats)
         sInterface->getThreadData()->stats.beginShaderLaunch(IG::ShaderType::Device, {});
@@ -611,7 +737,7 @@ void glue_render(const DriverRenderSettings* settings, IG::uint32 iter)
     ig_render(&renderSettings);
 
     if (sInterface->setup.acquire_stats)
-        sInterface->getThreadData()->stats.endShaderLaunch(IG::ShaderType::Device, {});
+        sInterface->getThreadData()->stats.endShaderLaunch(IG::ShaderType::Device, {}, 0);
 }
 
 void glue_setup(const DriverSetupSettings* settings)
@@ -642,11 +768,22 @@ void glue_clearFramebuffer(int aov)
     sInterface->clear(aov);
 }
 
+void glue_setFramebuffer(int aov, const float* data)
+{
+    sInterface->set(aov, data);
+}
+
 const IG::Statistics* glue_getStatistics()
 {
     return sInterface->getFullStats();
 }
 
+float* glue_getAdaptiveData(size_t* count)
+{
+    *count = sInterface->adaptive_data.size();
+    return sInterface->adaptive_data.empty() ? nullptr : sInterface->adaptive_data.data();
+}
+
 inline void get_ray_stream(RayStream& rays, float* ptr, size_t capacity)
 {
     static_assert(std::is_pod<RayStream>::value, "Expected RayStream to be plain old data");
@@ -717,7 +854,9 @@ IG_EXPORT DriverInterface ig_get_interface()
     interface.SetShaderSetFunction     = glue_setShaderSet;
     interface.GetFramebufferFunction   = glue_getFramebuffer;
     interface.ClearFramebufferFunction = glue_clearFramebuffer;
+    interface.SetFramebufferFunction   = glue_setFramebuffer;
     interface.GetStatisticsFunction    = glue_getStatistics;
+    interface.GetAdaptiveDataFunction  = glue_getAdaptiveData;
 
     return interface;
 }
@@ -778,9 +917,9 @@ void ignis_load_scene_info(int dev, SceneInfo* info)
     *info = sInterface->loadSceneInfo(dev);
 }
 
-void ignis_load_rays(int dev, StreamRay** list)
+void ignis_load_rays(int dev, StreamRayList* list)
 {
-    *list = const_cast<StreamRay*>(sInterface->loadRayList(dev).data());
+    sInterface->loadRayList(dev, list);
 }
 
 void ignis_load_image(int32_t dev, const char* file, float** pixels, int32_t* width, int32_t* height)
@@ -791,12 +930,24 @@ void ignis_load_image(int32_t dev, const char* file, float** pixels, int32_t* wi
     *height   = std::get<2>(img);
 }
 
+void ignis_load_camera_views(int dev, uint8_t** views, int* count)
+{
+    *views = reinterpret_cast<uint8_t*>(const_cast<float*>(sInterface->loadCameraViews(dev)));
+    *count = (int)(sInterface->camera_views.size() / CameraViewComponents);
+}
+
 void ignis_request_buffer(int32_t dev, const char* name, uint8_t** data, int size)
 {
     auto& buffer = sInterface->requestBuffer(dev, name, size);
     *data        = const_cast<uint8_t*>(std::get<0>(buffer).data());
 }
 
+void ignis_load_buffer(int32_t dev, const char* file, uint8_t** data)
+{
+    auto& buffer = sInterface->loadBuffer(dev, file);
+    *data        = const_cast<uint8_t*>(std::get<0>(buffer).data());
+}
+
 void ignis_cpu_get_primary_stream(PrimaryStream* primary, int size)
 {
     auto& array = sInterface->getCPUPrimaryStream(size);
@@ -916,6 +1067,46 @@ bool ignis_use_advanced_shadow_handling()
     return sInterface->useAdvancedShadowHandling();
 }
 
+bool ignis_get_adaptive_data(int dev, float** data, float** spp_aov, int* aov_count, float* target_error, int* film_iterations)
+{
+    IG_UNUSED(dev);
+
+    if (sInterface->adaptive_data.empty())
+        return false;
+
+    *data            = sInterface->adaptive_data.data();
+    *spp_aov         = sInterface->aovs[sInterface->setup.adaptive_aov - 1].data();
+    *aov_count       = (int)sInterface->setup.adaptive_aov - 1; // The spp aov is always the last one
+    *target_error    = sInterface->setup.adaptive_error;
+    *film_iterations = (int)sInterface->film_iterations;
+    return true;
+}
+
+int ignis_get_shadow_rays_per_hit()
+{
+    return (int)std::max<size_t>(1, sInterface->setup.shadow_rays_per_hit);
+}
+
+bool ignis_use_stats()
+{
+    return sInterface->setup.acquire_stats;
+}
+
+void ignis_stats_add_section(int type, int64_t elapsed_us)
+{
+    sInterface->getThreadData()->stats.addSection((IG::SectionType)type, (IG::uint64)elapsed_us);
+}
+
+void ignis_stats_add_quantity(int type, int64_t value)
+{
+    sInterface->getThreadData()->stats.increase((IG::Quantity)type, (IG::uint64)value);
+}
+
+void ignis_stats_add_bounce_rays(int bounce, int64_t count)
+{
+    sInterface->getThreadData()->stats.addBounceRays((size_t)bounce, (IG::uint64)count);
+}
+
 void ignis_present(int dev)
 {
     if (dev != 0)
@@ -0,0 +1,113 @@
+#include "CDF.h"
+#include "Color.h"
+#include "Image.h"
+#include "Logger.h"
+
+#include <fstream>
+
+#include <tbb/parallel_for.h>
+
+namespace IG {
+// Accumulates the given weights into a cdf with count + 1 entries, which starts at zero and ends at one.
+// Returns the sum of all weights. If all weights are zero, the cdf is uniform
+static inline float accumulate(float* cdf, size_t count)
+{
+    float sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const float weight = cdf[i + 1];
+        cdf[i]             = sum;
+        sum += weight;
+    }
+
+    if (sum > 0) {
+        const float inv = 1 / sum;
+        for (size_t i = 1; i < count; ++i)
+            cdf[i] *= inv;
+    } else {
+        for (size_t i = 1; i < count; ++i)
+            cdf[i] = i / (float)count;
+    }
+    cdf[count] = 1;
+
+    return sum;
+}
+
+bool CDF::computeForImage(const std::filesystem::path& in_image, const std::filesystem::path& out_data, size_t& slice_size, size_t& marginal_size, bool flip_x, bool flip_y)
+{
+    ImageRgba32 image;
+    try {
+        image = ImageRgba32::load(in_image);
+    } catch (const ImageLoadException& e) {
+        IG_LOG(L_ERROR) << e.what() << std::endl;
+        return false;
+    }
+
+    if (!image.isValid() || image.width == 0 || image.height == 0)
+        return false;
+
+    const size_t width  = image.width;
+    const size_t height = image.height;
+    slice_size          = width + 1;
+    marginal_size       = height + 1;
+
+    const auto luminance = [&](size_t x, size_t y) {
+        const float* pixel = &image.pixels[4 * (y * width + x)];
+        return std::max(0.0f, RGB(pixel[0], pixel[1], pixel[2]).luminance());
+    };
+
+    std::vector<float> data(marginal_size + height * slice_size);
+    float* marginal    = data.data();
+    float* conditional = data.data() + marginal_size;
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, height),
+                      [&](const tbb::blocked_range<size_t>& range) {
+                          for (size_t y = range.begin(); y != range.end(); ++y) {
+                              // A bilinear lookup inside a cell also reads the next pixel in both directions, which is the previous image pixel if flipped
+                              const size_t iy0 = flip_y ? height - 1 - y : y;
+                              const size_t iy1 = flip_y ? (iy0 > 0 ? iy0 - 1 : 0) : std::min(iy0 + 1, height - 1);
+
+                              const float sin_theta = std::sin(Pi * (y + 0.5f) / height);
+
+                              float* slice = &conditional[y * slice_size];
+                              for (size_t x = 0; x < width; ++x) {
+                                  const size_t ix0 = flip_x ? width - 1 - x : x;
+                                  const size_t ix1 = flip_x ? (ix0 > 0 ? ix0 - 1 : 0) : std::min(ix0 + 1, width - 1);
+
+                                  const float lum = std::max(std::max(luminance(ix0, iy0), luminance(ix1, iy0)),
+                                                             std::max(luminance(ix0, iy1), luminance(ix1, iy1)));
+                                  slice[x + 1]    = lum * sin_theta;
+                              }
+
+                              marginal[y + 1] = accumulate(slice, width);
+                          }
+                      });
+
+    accumulate(marginal, height);
+
+    std::ofstream stream(out_data, std::ios::binary | std::ios::trunc);
+    if (!stream) {
+        IG_LOG(L_ERROR) << "Could not write cdf to " << out_data << std::endl;
+        return false;
+    }
+
+    const uint32 sizes[2] = { (uint32)slice_size, (uint32)marginal_size };
+    stream.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+    stream.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(float));
+    return true;
+}
+
+bool CDF::loadSizes(const std::filesystem::path& data, size_t& slice_size, size_t& marginal_size)
+{
+    std::ifstream stream(data, std::ios::binary);
+    if (!stream)
+        return false;
+
+    uint32 sizes[2];
+    if (!stream.read(reinterpret_cast<char*>(sizes), sizeof(sizes)))
+        return false;
+
+    slice_size    = sizes[0];
+    marginal_size = sizes[1];
+    return slice_size > 1 && marginal_size > 1;
+}
+} // namespace IG
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "IG_Config.h"
+
+namespace IG {
+class CDF {
+public:
+    // Computes a 2d cdf proportional to the luminance of the given equirectangular image, weighted by the solid angle of its rows.
+    // The result is written to out_data as the slice and marginal size (two 32 bit unsigned integers), followed by raw floats,
+    // the marginal (height + 1 entries) first, followed by all conditionals (width + 1 entries each).
+    // Every cell covers at least the pixels a bilinear or nearest lookup inside it reads, such that no visible part of the image has a zero probability.
+    // The flip flags have the same meaning as for image textures, the cdf is always given in the space of the texture coordinates
+    static bool computeForImage(const std::filesystem::path& in_image, const std::filesystem::path& out_data, size_t& slice_size, size_t& marginal_size,
+                                bool flip_x = false, bool flip_y = false);
+
+    // Reads the sizes of a cdf written by computeForImage, which allows to use a cached cdf without loading the image
+    static bool loadSizes(const std::filesystem::path& data, size_t& slice_size, size_t& marginal_size);
+};
+} // namespace IG
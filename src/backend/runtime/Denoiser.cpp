@@ -0,0 +1,145 @@
+#include "Denoiser.h"
+
+#include <tbb/parallel_for.h>
+
+namespace IG {
+// B3 spline used by every à-trous pass
+static constexpr float Kernel[5]      = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+static constexpr float AlbedoEpsilon  = 1e-3f;
+static constexpr float DepthEpsilon   = 1e-4f;
+static constexpr float SigmaEpsilon   = 1e-8f;
+
+using RowArray = Eigen::Array<float, Eigen::Dynamic, 1>;
+using RowMap   = Eigen::Map<RowArray>;
+using CRowMap  = Eigen::Map<const RowArray>;
+
+template <typename Func>
+static inline void parallel_rows(size_t height, Func func)
+{
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, height),
+                      [&](const tbb::blocked_range<size_t>& range) {
+                          for (size_t y = range.begin(); y != range.end(); ++y)
+                              func(y);
+                      });
+}
+
+// Dark or missing albedo (e.g., background) is not demodulated
+static inline float albedo_divisor(const DenoiserInput& input, size_t ind)
+{
+    if (!input.Albedo)
+        return 1;
+    const float albedo = input.Albedo[ind] * input.Scale;
+    return albedo < AlbedoEpsilon ? 1 : albedo;
+}
+
+void Denoiser::apply(const DenoiserInput& input, const DenoiserSettings& settings, float* output)
+{
+    const size_t width  = input.Width;
+    const size_t height = input.Height;
+    const size_t pixels = width * height;
+
+    for (auto& buffer : mIrradiance)
+        buffer.resize(pixels * 3);
+    mTonemapped.resize(pixels * 3);
+    mDivisor.resize(pixels * 3);
+    mNormal.resize(input.Normal ? pixels * 3 : 0);
+    mDepth.resize(input.Depth ? pixels : 0);
+
+    // Demodulate albedo and convert to planar layout
+    parallel_rows(height, [&](size_t y) {
+        for (size_t x = 0; x < width; ++x) {
+            const size_t p = y * width + x;
+            for (size_t c = 0; c < 3; ++c) {
+                const size_t i                 = p * 3 + c;
+                mDivisor[c * pixels + p]       = albedo_divisor(input, i);
+                mIrradiance[0][c * pixels + p] = input.Color[i] / mDivisor[c * pixels + p];
+                if (input.Normal)
+                    mNormal[c * pixels + p] = input.Normal[i] * input.Scale;
+            }
+            if (input.Depth)
+                mDepth[p] = input.Depth[p * 3] * input.Scale;
+        }
+    });
+
+    const float normalFactor = 1 / std::max(SigmaEpsilon, settings.NormalSigma * settings.NormalSigma);
+    const float depthFactor  = 1 / std::max(SigmaEpsilon, settings.DepthSigma);
+
+    const auto row = [&](const std::vector<float>& buffer, size_t c, size_t start, size_t count) { return CRowMap(&buffer[c * pixels + start], count); };
+
+    float colorSigma = settings.ColorSigma;
+    for (uint32 pass = 0; pass < settings.Iterations; ++pass) {
+        const auto& src = mIrradiance[pass % 2];
+        auto& dst       = mIrradiance[(pass + 1) % 2];
+        const int step  = 1 << pass;
+
+        // Compress the dynamic range, else the edge stopping is dominated by fireflies and light sources
+        parallel_rows(height, [&](size_t y) {
+            for (size_t c = 0; c < 3; ++c) {
+                const RowArray v = (row(src, c, y * width, width) * input.Scale).max(0.0f);
+                RowMap(&mTonemapped[c * pixels + y * width], width) = v / (1 + v);
+            }
+        });
+
+        const float colorFactor = 1 / std::max(SigmaEpsilon, colorSigma * colorSigma);
+
+        parallel_rows(height, [&](size_t y) {
+            RowArray sum[3]    = { RowArray::Zero(width), RowArray::Zero(width), RowArray::Zero(width) };
+            RowArray weightSum = RowArray::Zero(width);
+
+            for (int ky = -2; ky <= 2; ++ky) {
+                const int qy = (int)y + ky * step;
+                if (qy < 0 || qy >= (int)height)
+                    continue;
+
+                for (int kx = -2; kx <= 2; ++kx) {
+                    // Apply the tap to all pixels of the row with a neighbour inside the image
+                    const int offset = kx * step;
+                    const int x0     = std::max(0, -offset);
+                    const int x1     = std::min((int)width, (int)width - offset);
+                    if (x0 >= x1)
+                        continue;
+
+                    const size_t count = x1 - x0;
+                    const size_t p     = y * width + x0;
+                    const size_t q     = (size_t)qy * width + x0 + offset;
+
+                    RowArray dist = RowArray::Zero(count);
+                    for (size_t c = 0; c < 3; ++c)
+                        dist += colorFactor * (row(mTonemapped, c, p, count) - row(mTonemapped, c, q, count)).square();
+
+                    if (input.Normal) {
+                        for (size_t c = 0; c < 3; ++c)
+                            dist += normalFactor * (row(mNormal, c, p, count) - row(mNormal, c, q, count)).square();
+                    }
+
+                    if (input.Depth) {
+                        const auto dp = row(mDepth, 0, p, count);
+                        dist += depthFactor * (dp - row(mDepth, 0, q, count)).abs() / dp.max(DepthEpsilon);
+                    }
+
+                    const RowArray weight = Kernel[kx + 2] * Kernel[ky + 2] * (-dist).exp();
+                    for (size_t c = 0; c < 3; ++c)
+                        sum[c].segment(x0, count) += weight * row(src, c, q, count);
+                    weightSum.segment(x0, count) += weight;
+                }
+            }
+
+            // The center pixel always has a positive weight
+            for (size_t c = 0; c < 3; ++c)
+                RowMap(&dst[c * pixels + y * width], width) = sum[c] / weightSum;
+        });
+
+        colorSigma *= 0.5f;
+    }
+
+    // Remodulate albedo and convert back to interleaved layout
+    const auto& result = mIrradiance[settings.Iterations % 2];
+    parallel_rows(height, [&](size_t y) {
+        for (size_t x = 0; x < width; ++x) {
+            const size_t p = y * width + x;
+            for (size_t c = 0; c < 3; ++c)
+                output[p * 3 + c] = result[c * pixels + p] * mDivisor[c * pixels + p];
+        }
+    });
+}
+} // namespace IG
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "IG_Config.h"
+
+namespace IG {
+struct DenoiserSettings {
+    uint32 Iterations = 5;    // Number of à-trous passes, the footprint of the filter doubles with each pass
+    float ColorSigma  = 0.5f; // Edge stopping on the (tonemapped) color, halved with each pass
+    float NormalSigma = 0.2f; // Edge stopping on the normal aov
+    float DepthSigma  = 0.1f; // Edge stopping on the depth aov, relative to the depth of the center pixel
+};
+
+// All buffers are rgb triplets with the given size. The guides are optional and can be null
+struct DenoiserInput {
+    size_t Width;
+    size_t Height;
+    float Scale; // Scale applied to all buffers to get the mean value of a pixel, e.g., 1/iterations
+    const float* Color;
+    const float* Normal;
+    const float* Albedo;
+    const float* Depth; // Only the first component is used
+};
+
+// Edge-avoiding à-trous wavelet filter [Dammertz et al. 2010].
+// The color is demodulated by the albedo before filtering, such that textures stay sharp.
+// All internal buffers are planar (one plane per component), such that every kernel tap is applied to a whole row at once
+class Denoiser {
+public:
+    // Output has the same size and scale as the input color. It is not allowed to alias the input
+    void apply(const DenoiserInput& input, const DenoiserSettings& settings, float* output);
+
+private:
+    std::vector<float> mIrradiance[2]; // Ping-pong buffers of the demodulated color
+    std::vector<float> mTonemapped;    // Color used for the edge stopping function of the current pass
+    std::vector<float> mDivisor;       // Albedo the color is demodulated with
+    std::vector<float> mNormal;        // Scaled normal guide, empty if not available
+    std::vector<float> mDepth;         // Scaled depth guide, empty if not available
+};
+} // namespace IG
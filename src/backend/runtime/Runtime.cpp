@@ -3,6 +3,7 @@
 #include "Logger.h"
 #include "jit.h"
 #include "loader/Parser.h"
+#include "serialization/FileSerializer.h"
 
 #include <chrono>
 #include <fstream>
@@ -24,16 +25,22 @@ static inline void setup_technique(LoaderOptions& lopts, const RuntimeOptions& o
     lopts.TechniqueType = tech_type;
 }
 
-static inline void setup_film(RuntimeRenderSettings& settings, const LoaderOptions& lopts, const RuntimeOptions& opts)
+static inline void setup_film(RuntimeRenderSettings& settings, LoaderOptions& lopts, const RuntimeOptions& opts)
 {
-    IG_UNUSED(opts);
+    std::string sampler_type = "uniform";
 
     const auto film = lopts.Scene.film();
     if (film) {
         const auto filmSize = film->property("size").getVector2(Vector2f(settings.FilmWidth, settings.FilmHeight));
         settings.FilmWidth  = filmSize.x();
         settings.FilmHeight = filmSize.y();
+        sampler_type        = film->property("sampler").getString(sampler_type);
     }
+
+    if (!opts.OverridePixelSampler.empty())
+        sampler_type = opts.OverridePixelSampler;
+
+    lopts.PixelSamplerType = sampler_type;
 }
 
 static inline void setup_camera(RuntimeRenderSettings& settings, LoaderOptions& lopts, const RuntimeOptions& opts)
@@ -88,10 +95,19 @@ Runtime::Runtime(const std::filesystem::path& path, const RuntimeOptions& opts)
     , mOptions(opts)
     , mDevice(opts.Device)
     , mCurrentIteration(0)
+    , mSeedOffset(0)
+    , mFramebufferWidth(0)
+    , mFramebufferHeight(0)
+    , mCameraCount(1)
+    , mFilmIterations(0)
+    , mAdaptiveError(0)
+    , mCurrentTechniqueVariant(0)
+    , mShadowRaysPerHit(1)
     , mIsTrace(false)
     , mIsDebug(false)
     , mDebugMode(DebugMode::Normal)
     , mAcquireStats(opts.AcquireStats)
+    , mHasDenoiser(false)
 {
     if (!mManager.init())
         throw std::runtime_error("Could not init modules!");
@@ -114,12 +130,14 @@ Runtime::Runtime(const std::filesystem::path& path, const RuntimeOptions& opts)
     // Parse scene file
     IG_LOG(L_DEBUG) << "Parsing scene" << std::endl;
     const auto startParser = std::chrono::high_resolution_clock::now();
+    const uint64 startNS   = Statistics::timestampNS();
     Parser::SceneParser parser;
     bool ok     = false;
     lopts.Scene = parser.loadFromFile(path, ok);
     if (!ok)
         throw std::runtime_error("Could not parse scene!");
     IG_LOG(L_DEBUG) << "Parsing scene took " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - startParser).count() / 1000.0f << " seconds" << std::endl;
+    mLoadStatistics.addPhase("Parser", startNS, Statistics::timestampNS() - startNS);
 
     // Extract technique
     setup_technique(lopts, opts);
@@ -130,6 +148,13 @@ Runtime::Runtime(const std::filesystem::path& path, const RuntimeOptions& opts)
     // Extract camera
     setup_camera(mLoadedRenderSettings, lopts, opts);
 
+    // Multiple views are only supported by camera drivers
+    if (lopts.CameraType != "list")
+        mCameraCount = std::max(1u, opts.CameraCount);
+    lopts.CameraCount = mCameraCount;
+    lopts.Denoise     = opts.Denoise;
+    lopts.CacheDir    = opts.CacheDir;
+
     // Check configuration
     const Target newTarget = mManager.resolveTarget(lopts.Target);
     if (newTarget != lopts.Target) {
@@ -157,10 +182,35 @@ Runtime::Runtime(const std::filesystem::path& path, const RuntimeOptions& opts)
     if (!Loader::load(lopts, result))
         throw std::runtime_error("Could not load scene!");
     mDatabase = std::move(result.Database);
+    for (const auto& phase : result.Phases)
+        mLoadStatistics.addPhase(phase.Name, phase.StartNS, phase.DurationNS);
+
+    mIsDebug          = lopts.TechniqueType == "debug";
+    mIsTrace          = lopts.CameraType == "list";
+    mAOVs             = std::move(result.AOVs);
+    mShadowRaysPerHit = result.ShadowRaysPerHit;
+    mCameraCount      = (uint32)result.CameraCount;
+
+    if (opts.AdaptiveError > 0) {
+        if (mIsTrace) {
+            IG_LOG(L_WARNING) << "Adaptive sampling is not supported by trace drivers" << std::endl;
+        } else if (!isCPU(mTarget)) {
+            IG_LOG(L_WARNING) << "Adaptive sampling is only supported on CPU targets" << std::endl;
+        } else if (result.OverridesCamera) {
+            // Tiles are rescaled to redistribute samples, which does not work with contributions splatted from other tiles
+            IG_LOG(L_WARNING) << "Adaptive sampling is not supported by techniques overriding the camera" << std::endl;
+        } else {
+            mAdaptiveError = opts.AdaptiveError;
+            mAOVs.push_back("Effective SPP");
+        }
+    }
 
-    mIsDebug = lopts.TechniqueType == "debug";
-    mIsTrace = lopts.CameraType == "list";
-    mAOVs    = std::move(result.AOVs);
+    if (opts.Denoise) {
+        if (mIsTrace)
+            IG_LOG(L_WARNING) << "Denoising is not supported by trace drivers" << std::endl;
+        else
+            mHasDenoiser = true;
+    }
 
     if (opts.DumpShader) {
         for (size_t i = 0; i < mTechniqueVariants.size(); ++i) {
@@ -180,7 +230,8 @@ Runtime::Runtime(const std::filesystem::path& path, const RuntimeOptions& opts)
         }
     }
 
-    mTechniqueVariants = std::move(result.TechniqueVariants);
+    mTechniqueVariants        = std::move(result.TechniqueVariants);
+    mTechniqueVariantSelector = result.VariantSelector;
 
     // Force flush to zero mode for denormals
 #if defined(__x86_64__) || defined(__amd64__) || defined(_M_X64)
@@ -203,6 +254,11 @@ void Runtime::step(const Camera& camera)
         return;
     }
 
+    if (mCameraCount > 1) {
+        step(std::vector<Camera>(mCameraCount, camera));
+        return;
+    }
+
     handleTechniqueVariants(mCurrentIteration);
 
     DriverRenderSettings settings;
@@ -214,19 +270,86 @@ void Runtime::step(const Camera& camera)
         settings.up[i] = camera.Up(i);
     for (int i = 0; i < 3; ++i)
         settings.right[i] = camera.Right(i);
-    settings.width      = camera.SensorWidth;
-    settings.height     = camera.SensorHeight;
-    settings.tmin       = camera.TMin;
-    settings.tmax       = camera.TMax;
-    settings.rays       = nullptr; // No artifical ray streams
-    settings.device     = mDevice;
-    settings.spi        = mSamplesPerIteration;
-    settings.debug_mode = (uint32)mDebugMode;
-
-    mLoadedInterface.RenderFunction(&settings, mCurrentIteration++);
+    settings.width           = camera.SensorWidth;
+    settings.height          = camera.SensorHeight;
+    settings.tmin            = camera.TMin;
+    settings.tmax            = camera.TMax;
+    settings.rays            = nullptr; // No artifical ray streams
+    settings.camera_views    = nullptr;
+    settings.camera_count    = 1;
+    settings.film_iterations = mFilmIterations++;
+    settings.device          = mDevice;
+    settings.spi             = mSamplesPerIteration;
+    settings.debug_mode      = (uint32)mDebugMode;
+
+    mLoadedInterface.RenderFunction(&settings, mSeedOffset + mCurrentIteration++);
 }
 
-void Runtime::trace(const std::vector<Ray>& rays, std::vector<float>& data)
+void Runtime::step(const std::vector<Camera>& cameras)
+{
+    IG_ASSERT(mInit, "Expected to be initialized!");
+
+    if (mIsTrace) {
+        IG_LOG(L_ERROR) << "Trying to use step() in a trace driver!" << std::endl;
+        return;
+    }
+
+    if (cameras.size() != mCameraCount) {
+        IG_LOG(L_ERROR) << "Expected " << mCameraCount << " cameras but " << cameras.size() << " were given!" << std::endl;
+        return;
+    }
+
+    if (mCameraCount == 1) {
+        step(cameras.front());
+        return;
+    }
+
+    handleTechniqueVariants(mCurrentIteration);
+
+    // Has to be in sync with the multi camera emitter
+    mCameraViews.resize(cameras.size() * 16);
+    for (size_t c = 0; c < cameras.size(); ++c) {
+        const Camera& camera = cameras[c];
+        float* view          = &mCameraViews[c * 16];
+        for (int i = 0; i < 3; ++i) {
+            view[0 + i] = camera.Eye(i);
+            view[3 + i] = camera.Direction(i);
+            view[6 + i] = camera.Up(i);
+            view[9 + i] = camera.Right(i);
+        }
+        view[12] = camera.SensorWidth;
+        view[13] = camera.SensorHeight;
+        view[14] = camera.TMin;
+        view[15] = camera.TMax;
+    }
+
+    // The single camera parameters are still given for drivers ignoring the views
+    const Camera& camera = cameras.front();
+    DriverRenderSettings settings;
+    for (int i = 0; i < 3; ++i)
+        settings.eye[i] = camera.Eye(i);
+    for (int i = 0; i < 3; ++i)
+        settings.dir[i] = camera.Direction(i);
+    for (int i = 0; i < 3; ++i)
+        settings.up[i] = camera.Up(i);
+    for (int i = 0; i < 3; ++i)
+        settings.right[i] = camera.Right(i);
+    settings.width           = camera.SensorWidth;
+    settings.height          = camera.SensorHeight;
+    settings.tmin            = camera.TMin;
+    settings.tmax            = camera.TMax;
+    settings.rays            = nullptr;
+    settings.camera_views    = mCameraViews.data();
+    settings.camera_count    = mCameraCount;
+    settings.film_iterations = mFilmIterations++;
+    settings.device          = mDevice;
+    settings.spi             = mSamplesPerIteration;
+    settings.debug_mode      = (uint32)mDebugMode;
+
+    mLoadedInterface.RenderFunction(&settings, mSeedOffset + mCurrentIteration++);
+}
+
+void Runtime::trace(const RayBatch& batch, float* radiance, uint32 iterations)
 {
     if (!mInit)
         return;
@@ -236,20 +359,67 @@ void Runtime::trace(const std::vector<Ray>& rays, std::vector<float>& data)
         return;
     }
 
-    handleTechniqueVariants(mCurrentIteration);
+    if (batch.Count == 0 || iterations == 0)
+        return;
 
-    DriverRenderSettings settings;
-    settings.width  = rays.size();
-    settings.height = 1;
-    settings.rays   = rays.data();
-    settings.device = mDevice;
+    // Results of previous calls should not be accumulated
+    clearFramebuffer();
 
-    mLoadedInterface.RenderFunction(&settings, mCurrentIteration++);
+    DriverRenderSettings settings;
+    settings.width           = batch.Count;
+    settings.height          = 1;
+    settings.rays            = nullptr;
+    settings.camera_views    = nullptr;
+    settings.camera_count    = 1;
+    settings.film_iterations = 0;
+    settings.device          = mDevice;
+    settings.spi             = mSamplesPerIteration;
+    settings.debug_mode      = (uint32)mDebugMode;
+
+    for (uint32 i = 0; i < iterations; ++i) {
+        settings.rays = i == 0 ? &batch : nullptr; // Only upload the rays once
+        handleTechniqueVariants(mCurrentIteration);
+        mLoadedInterface.RenderFunction(&settings, mSeedOffset + mCurrentIteration++);
+    }
 
     // Get result
     const float* data_ptr = getFramebuffer(0);
-    data.resize(rays.size() * 3);
-    std::memcpy(data.data(), data_ptr, sizeof(float) * rays.size() * 3);
+    const float scale     = 1.0f / iterations;
+    for (size_t i = 0; i < batch.Count * 3; ++i)
+        radiance[i] = data_ptr[i] * scale;
+}
+
+void Runtime::trace(const std::vector<Ray>& rays, std::vector<float>& data, uint32 iterations)
+{
+    const size_t count = rays.size();
+    mRayBatchScratch.resize(count * 8);
+
+    float* ptr = mRayBatchScratch.data();
+    for (size_t i = 0; i < count; ++i) {
+        const Ray& ray     = rays[i];
+        ptr[0 * count + i] = ray.Origin(0);
+        ptr[1 * count + i] = ray.Origin(1);
+        ptr[2 * count + i] = ray.Origin(2);
+        ptr[3 * count + i] = ray.Direction(0);
+        ptr[4 * count + i] = ray.Direction(1);
+        ptr[5 * count + i] = ray.Direction(2);
+        ptr[6 * count + i] = ray.Range(0);
+        ptr[7 * count + i] = ray.Range(1);
+    }
+
+    RayBatch batch;
+    batch.OriginX    = ptr + 0 * count;
+    batch.OriginY    = ptr + 1 * count;
+    batch.OriginZ    = ptr + 2 * count;
+    batch.DirectionX = ptr + 3 * count;
+    batch.DirectionY = ptr + 4 * count;
+    batch.DirectionZ = ptr + 5 * count;
+    batch.TMin       = ptr + 6 * count;
+    batch.TMax       = ptr + 7 * count;
+    batch.Count      = count;
+
+    data.resize(count * 3);
+    trace(batch, data.data(), iterations);
 }
 
 const float* Runtime::getFramebuffer(int aov) const
@@ -257,27 +427,224 @@ const float* Runtime::getFramebuffer(int aov) const
     return mLoadedInterface.GetFramebufferFunction(aov);
 }
 
+const float* Runtime::getCameraFramebuffer(uint32 camera, int aov) const
+{
+    if (camera >= mCameraCount)
+        return nullptr;
+
+    const size_t viewSize = (size_t)mFramebufferWidth * (mFramebufferHeight / mCameraCount) * 3;
+    return getFramebuffer(aov) + camera * viewSize;
+}
+
 void Runtime::clearFramebuffer(int aov)
 {
+    if (aov <= 0)
+        mFilmIterations = 0;
     return mLoadedInterface.ClearFramebufferFunction(aov);
 }
 
-const Statistics* Runtime::getStatistics() const
+const float* Runtime::denoise(const DenoiserSettings& settings)
+{
+    if (!mInit || !mHasDenoiser)
+        return nullptr;
+
+    const auto getAOV = [&](const char* name) -> const float* {
+        const auto it = std::find(mAOVs.begin(), mAOVs.end(), name);
+        return it == mAOVs.end() ? nullptr : getFramebuffer((int)std::distance(mAOVs.begin(), it) + 1);
+    };
+
+    const float* color  = getFramebuffer(0);
+    const float* normal = getAOV("Normals");
+    const float* albedo = getAOV("Albedo");
+    const float* depth  = getAOV("Depth");
+
+    const size_t viewHeight = mFramebufferHeight / mCameraCount;
+    const size_t viewSize   = (size_t)mFramebufferWidth * viewHeight * 3;
+    for (size_t c = 0; c < mCameraCount; ++c) {
+        const size_t offset = c * viewSize;
+
+        DenoiserInput input;
+        input.Width  = mFramebufferWidth;
+        input.Height = viewHeight;
+        input.Scale  = 1.0f / std::max(1u, mFilmIterations);
+        input.Color  = color + offset;
+        input.Normal = normal ? normal + offset : nullptr;
+        input.Albedo = albedo ? albedo + offset : nullptr;
+        input.Depth  = depth ? depth + offset : nullptr;
+
+        mDenoiser.apply(input, settings, mDenoisedFramebuffer.data() + offset);
+    }
+
+    return mDenoisedFramebuffer.data();
+}
+
+constexpr uint32 FILM_MAGIC   = 0x00464749; // "IGF\0"
+constexpr uint32 FILM_VERSION = 2;
+
+/* File layout (little endian):
+ *  Header:   [magic, version, width, height, iteration, film iterations, seed offset, layer count] as uint32
+ *  Layer[i]: [name] as string, followed by width * height * 3 floats. The first layer is always the framebuffer
+ *  Adaptive: [count] as uint32, followed by count floats of per pixel statistics. Zero if adaptive sampling is disabled
+ */
+bool Runtime::saveFilm(const std::filesystem::path& path) const
+{
+    if (!mInit || mIsTrace)
+        return false;
+
+    FileSerializer serializer(path, false);
+    if (!serializer.isValid()) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' can not be opened for writing." << std::endl;
+        return false;
+    }
+
+    const size_t layerSize = (size_t)mFramebufferWidth * mFramebufferHeight * 3;
+
+    serializer.write(FILM_MAGIC);
+    serializer.write(FILM_VERSION);
+    serializer.write(mFramebufferWidth);
+    serializer.write(mFramebufferHeight);
+    serializer.write(mCurrentIteration);
+    serializer.write(mFilmIterations);
+    serializer.write(mSeedOffset);
+    serializer.write((uint32)(mAOVs.size() + 1));
+
+    for (size_t i = 0; i <= mAOVs.size(); ++i) {
+        serializer.write(i == 0 ? std::string("Default") : mAOVs[i - 1]);
+        serializer.writeRaw(reinterpret_cast<const uint8*>(getFramebuffer((int)i)), layerSize * sizeof(float));
+    }
+
+    size_t adaptiveCount  = 0;
+    const float* adaptive = mLoadedInterface.GetAdaptiveDataFunction(&adaptiveCount);
+    serializer.write((uint32)adaptiveCount);
+    if (adaptive)
+        serializer.writeRaw(reinterpret_cast<const uint8*>(adaptive), adaptiveCount * sizeof(float));
+
+    return true;
+}
+
+bool Runtime::loadFilm(const std::filesystem::path& path)
+{
+    if (!mInit || mIsTrace)
+        return false;
+
+    FileSerializer serializer(path, true);
+    if (!serializer.isValid()) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' can not be opened." << std::endl;
+        return false;
+    }
+
+    uint32 header[8];
+    if (serializer.readRaw(reinterpret_cast<uint8*>(header), sizeof(header)) != sizeof(header) || header[0] != FILM_MAGIC) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' is not a valid Ignis film file." << std::endl;
+        return false;
+    }
+
+    if (header[1] != FILM_VERSION) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' has an unsupported version number " << header[1] << " != " << FILM_VERSION << "." << std::endl;
+        return false;
+    }
+
+    if (header[2] != mFramebufferWidth || header[3] != mFramebufferHeight) {
+        IG_LOG(L_ERROR) << "Film " << path << " has size " << header[2] << "x" << header[3]
+                        << " but the framebuffer has size " << mFramebufferWidth << "x" << mFramebufferHeight << "." << std::endl;
+        return false;
+    }
+
+    const size_t layerSize = (size_t)mFramebufferWidth * mFramebufferHeight * 3;
+    std::vector<std::vector<float>> layers(mAOVs.size() + 1);
+    for (uint32 i = 0; i < header[7]; ++i) {
+        std::string name;
+        serializer.read(name);
+
+        std::vector<float> data(layerSize);
+        if (serializer.readRaw(reinterpret_cast<uint8*>(data.data()), layerSize * sizeof(float)) != layerSize * sizeof(float)) {
+            IG_LOG(L_ERROR) << "Film " << path << ": Could not read layer '" << name << "'." << std::endl;
+            return false;
+        }
+
+        if (i == 0) {
+            layers[0] = std::move(data);
+            continue;
+        }
+
+        const auto it = std::find(mAOVs.begin(), mAOVs.end(), name);
+        if (it == mAOVs.end())
+            IG_LOG(L_WARNING) << "Film " << path << ": Ignoring unknown layer '" << name << "'." << std::endl;
+        else
+            layers[std::distance(mAOVs.begin(), it) + 1] = std::move(data);
+    }
+
+    if (layers[0].empty()) {
+        IG_LOG(L_ERROR) << "Film " << path << " does not contain a framebuffer." << std::endl;
+        return false;
+    }
+
+    uint32 adaptiveCount = 0;
+    serializer.read(adaptiveCount);
+    std::vector<float> adaptive(adaptiveCount);
+    if (serializer.readRaw(reinterpret_cast<uint8*>(adaptive.data()), adaptiveCount * sizeof(float)) != adaptiveCount * sizeof(float)) {
+        IG_LOG(L_ERROR) << "Film " << path << ": Could not read adaptive sampling statistics." << std::endl;
+        return false;
+    }
+
+    clearFramebuffer();
+    for (size_t i = 0; i < layers.size(); ++i) {
+        if (layers[i].empty())
+            IG_LOG(L_WARNING) << "Film " << path << ": Missing layer '" << mAOVs[i - 1] << "', its content is cleared." << std::endl;
+        else
+            mLoadedInterface.SetFramebufferFunction((int)i, layers[i].data());
+    }
+
+    // Has to be set after the framebuffer, which resets the statistics
+    size_t currentAdaptiveCount = 0;
+    if (float* currentAdaptive = mLoadedInterface.GetAdaptiveDataFunction(&currentAdaptiveCount)) {
+        if (currentAdaptiveCount == adaptive.size())
+            std::copy(adaptive.begin(), adaptive.end(), currentAdaptive);
+        else
+            IG_LOG(L_WARNING) << "Film " << path << " does not contain matching adaptive sampling statistics, they are gathered again." << std::endl;
+    }
+
+    mCurrentIteration = header[4];
+    mFilmIterations   = header[5];
+    mSeedOffset       = header[6];
+    return true;
+}
+
+const Statistics* Runtime::getStatistics()
 {
-    return mAcquireStats ? mLoadedInterface.GetStatisticsFunction() : nullptr;
+    if (!mAcquireStats)
+        return nullptr;
+
+    mStatistics.reset();
+    mStatistics.add(mLoadStatistics);
+    if (const Statistics* driverStats = mLoadedInterface.GetStatisticsFunction())
+        mStatistics.add(*driverStats);
+    return &mStatistics;
 }
 
 void Runtime::setup(uint32 framebuffer_width, uint32 framebuffer_height)
 {
     DriverSetupSettings settings;
-    settings.database           = &mDatabase;
-    settings.framebuffer_width  = std::max(1u, framebuffer_width);
-    settings.framebuffer_height = std::max(1u, framebuffer_height);
-    settings.acquire_stats      = mAcquireStats;
-    settings.aov_count          = mAOVs.size();
+    settings.database            = &mDatabase;
+    settings.framebuffer_width   = std::max(1u, framebuffer_width);
+    settings.framebuffer_height  = std::max(1u, framebuffer_height) * mCameraCount; // Views are stacked vertically
+    settings.acquire_stats       = mAcquireStats;
+    settings.record_timeline     = mAcquireStats && mOptions.RecordTimeline;
+    settings.aov_count           = mAOVs.size();
+    settings.adaptive_error      = mAdaptiveError;
+    settings.adaptive_aov        = isAdaptive() ? mAOVs.size() : 0; // Always the last one
+    settings.shadow_rays_per_hit = mShadowRaysPerHit;
+
+    mFramebufferWidth  = settings.framebuffer_width;
+    mFramebufferHeight = settings.framebuffer_height;
+
+    if (mHasDenoiser)
+        mDenoisedFramebuffer.resize((size_t)mFramebufferWidth * mFramebufferHeight * 3, 0.0f);
 
     IG_LOG(L_DEBUG) << "Init JIT compiling" << std::endl;
+    const uint64 startNS = Statistics::timestampNS();
     ig_init_jit(mManager.getPath(mTarget).generic_u8string());
+    mLoadStatistics.addPhase("JIT Init", startNS, Statistics::timestampNS() - startNS);
     mLoadedInterface.SetupFunction(&settings);
 
     compileShaders();
@@ -293,38 +660,36 @@ void Runtime::shutdown()
 
 void Runtime::compileShaders()
 {
+    const auto compile = [&](const std::string& name, const std::string& src, const std::string& function, const std::filesystem::path& debugPath) {
+        const uint64 startNS = Statistics::timestampNS();
+        void* shader         = ig_compile_source(src, function, mOptions.DumpShaderFull ? &debugPath : nullptr);
+        mLoadStatistics.addPhase("JIT " + name, startNS, Statistics::timestampNS() - startNS);
+        return shader;
+    };
+
     mTechniqueVariantShaderSets.resize(mTechniqueVariants.size());
     for (size_t i = 0; i < mTechniqueVariants.size(); ++i) {
         const auto& variant = mTechniqueVariants[i];
         auto& shaders       = mTechniqueVariantShaderSets[i];
+        const std::string v = "v" + std::to_string(i);
 
         IG_LOG(L_DEBUG) << "Handling technique variant " << i << std::endl;
         IG_LOG(L_DEBUG) << "Compiling ray generation shader" << std::endl;
-        const std::filesystem::path rgp = "v" + std::to_string(i) + "_rayGenerationFull.art";
-        shaders.RayGenerationShader     = ig_compile_source(variant.RayGenerationShader, "ig_ray_generation_shader",
-                                                        mOptions.DumpShaderFull ? &rgp : nullptr);
+        shaders.RayGenerationShader = compile(v + "_rayGeneration", variant.RayGenerationShader, "ig_ray_generation_shader", v + "_rayGenerationFull.art");
 
         IG_LOG(L_DEBUG) << "Compiling miss shader" << std::endl;
-        const std::filesystem::path mp = "v" + std::to_string(i) + "_missShaderFull.art";
-        shaders.MissShader             = ig_compile_source(variant.MissShader, "ig_miss_shader",
-                                               mOptions.DumpShaderFull ? &mp : nullptr);
+        shaders.MissShader = compile(v + "_missShader", variant.MissShader, "ig_miss_shader", v + "_missShaderFull.art");
 
         IG_LOG(L_DEBUG) << "Compiling hit shaders" << std::endl;
         for (size_t j = 0; j < variant.HitShaders.size(); ++j) {
             IG_LOG(L_DEBUG) << "Hit shader [" << i << "]" << std::endl;
-            const std::filesystem::path hp = "v" + std::to_string(i) + "_hitShaderFull" + std::to_string(j) + ".art";
-            shaders.HitShaders.push_back(ig_compile_source(variant.HitShaders[j], "ig_hit_shader", mOptions.DumpShaderFull ? &hp : nullptr));
+            shaders.HitShaders.push_back(compile(v + "_hitShader" + std::to_string(j), variant.HitShaders[j], "ig_hit_shader", v + "_hitShaderFull" + std::to_string(j) + ".art"));
         }
 
         if (!variant.AdvancedShadowHitShader.empty()) {
             IG_LOG(L_DEBUG) << "Compiling advanced shadow shaders" << std::endl;
-            const std::filesystem::path ash = "v" + std::to_string(i) + "_advancedShadowHitFull.art";
-            shaders.AdvancedShadowHitShader = ig_compile_source(variant.AdvancedShadowHitShader, "ig_advanced_shadow_shader",
-                                                                mOptions.DumpShaderFull ? &ash : nullptr);
-
-            const std::filesystem::path asm_ = "v" + std::to_string(i) + "_advancedShadowMissFull.art";
-            shaders.AdvancedShadowMissShader = ig_compile_source(variant.AdvancedShadowMissShader, "ig_advanced_shadow_shader",
-                                                                 mOptions.DumpShaderFull ? &asm_ : nullptr);
+            shaders.AdvancedShadowHitShader  = compile(v + "_advancedShadowHit", variant.AdvancedShadowHitShader, "ig_advanced_shadow_shader", v + "_advancedShadowHitFull.art");
+            shaders.AdvancedShadowMissShader = compile(v + "_advancedShadowMiss", variant.AdvancedShadowMissShader, "ig_advanced_shadow_shader", v + "_advancedShadowMissFull.art");
         }
     }
 }
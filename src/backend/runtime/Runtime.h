@@ -1,6 +1,7 @@
 #pragma once
 
 #include "DebugMode.h"
+#include "Denoiser.h"
 #include "Statistics.h"
 #include "driver/DriverManager.h"
 #include "loader/Loader.h"
@@ -14,6 +15,7 @@ struct RuntimeOptions {
     bool DumpShader      = false;
     bool DumpShaderFull  = false;
     bool AcquireStats    = false;
+    bool RecordTimeline  = false; // Record every shader launch, requires AcquireStats
     Target DesiredTarget = Target::INVALID;
     bool RecommendCPU    = true;
     bool RecommendGPU    = true;
@@ -21,6 +23,11 @@ struct RuntimeOptions {
     uint32 SPI           = 0; // Detect automatically
     std::string OverrideTechnique;
     std::string OverrideCamera;
+    std::string OverridePixelSampler;
+    uint32 CameraCount   = 1; // Number of views rendered at once, ignored by trace drivers
+    float AdaptiveError  = 0; // Target relative error per pixel for adaptive sampling. Zero disables it. Only supported on CPU targets
+    bool Denoise         = false; // Enable the albedo, normal and depth aovs used by denoise(). Only supported by the path technique
+    std::string CacheDir = "data"; // Directory for generated data reused across runs, e.g., sky textures
 };
 
 struct RuntimeRenderSettings {
@@ -40,6 +47,20 @@ struct Ray {
     Vector2f Range;
 };
 
+// Rays as structure of arrays owned by the caller. Every array has to contain Count entries.
+// Directions do not have to be normalized
+struct RayBatch {
+    const float* OriginX;
+    const float* OriginY;
+    const float* OriginZ;
+    const float* DirectionX;
+    const float* DirectionY;
+    const float* DirectionZ;
+    const float* TMin;
+    const float* TMax;
+    size_t Count;
+};
+
 class Runtime {
 public:
     Runtime(const std::filesystem::path& path, const RuntimeOptions& opts);
@@ -47,17 +68,53 @@ public:
 
     void setup(uint32 framebuffer_width, uint32 framebuffer_height);
     void step(const Camera& camera);
-    void trace(const std::vector<Ray>& rays, std::vector<float>& data);
+    // Render one iteration for every view. The number of cameras has to match the camera count given at construction.
+    // All cameras have to share the sensor size given in setup()
+    void step(const std::vector<Camera>& cameras);
+    // Trace the given rays and write the radiance averaged over all iterations as rgb triplets into the given buffer,
+    // which has to be large enough to contain 3*Count entries. The count may change between calls.
+    // The rays are used without any copy on CPU targets
+    void trace(const RayBatch& batch, float* radiance, uint32 iterations = 1);
+    // Convenience function for rays given as array of structures
+    void trace(const std::vector<Ray>& rays, std::vector<float>& data, uint32 iterations = 1);
 
     const float* getFramebuffer(int aov = 0) const;
+    // Part of the framebuffer belonging to the given camera. Views are stacked vertically, each framebufferHeight() / cameraCount() rows high
+    const float* getCameraFramebuffer(uint32 camera, int aov = 0) const;
     // aov<0 will clear all aovs
     void clearFramebuffer(int aov = -1);
+
+    // Denoise the framebuffer guided by the albedo, normal and depth aovs, if available. Every view is filtered on its own.
+    // The result has the same scale as the framebuffer, i.e., it has to be normalized by currentFilmIterationCount(), and stays valid until the next call to setup()
+    const float* denoise(const DenoiserSettings& settings = DenoiserSettings());
+    // Result of the last call to denoise(). Returns null if the denoiser is not enabled
+    inline const float* getDenoisedFramebuffer() const { return mDenoisedFramebuffer.empty() ? nullptr : mDenoisedFramebuffer.data(); }
+    inline bool hasDenoiser() const { return mHasDenoiser; }
     inline const std::vector<std::string> aovs() const { return mAOVs; }
 
     inline uint32 currentTechniqueVariant() const { return mCurrentTechniqueVariant; }
     inline uint32 currentIterationCount() const { return mCurrentIteration; }
+    // Iterations accumulated in the framebuffer since the last clear. Use this to normalize the framebuffer
+    inline uint32 currentFilmIterationCount() const { return mFilmIterations; }
+
+    // Offset added to the iteration number used to seed the random number generators.
+    // Renderings of the same scene with offsets further apart than their iteration count are independent
+    inline uint32 seedOffset() const { return mSeedOffset; }
+    inline void setSeedOffset(uint32 offset) { mSeedOffset = offset; }
 
-    const Statistics* getStatistics() const;
+    // Save the accumulated (not normalized) framebuffer and aovs alongside the iteration counts, seed offset and adaptive sampling statistics
+    bool saveFilm(const std::filesystem::path& path) const;
+    // Replace the framebuffer and aovs with the content of the given file and continue counting iterations from there.
+    // The file has to match the current framebuffer size
+    bool loadFilm(const std::filesystem::path& path);
+
+    inline uint32 framebufferWidth() const { return mFramebufferWidth; }
+    inline uint32 framebufferHeight() const { return mFramebufferHeight; }
+    inline uint32 cameraCount() const { return mCameraCount; }
+    inline bool isAdaptive() const { return mAdaptiveError > 0; }
+
+    // Statistics of the driver merged with the loading and compiling phases. Returns null if statistics are not acquired
+    const Statistics* getStatistics();
 
     inline const RuntimeRenderSettings& loadedRenderSettings() const { return mLoadedRenderSettings; }
 
@@ -88,13 +145,28 @@ private:
     Target mTarget;
 
     uint32 mCurrentIteration;
+    uint32 mSeedOffset;
+    uint32 mFramebufferWidth;
+    uint32 mFramebufferHeight;
+    uint32 mCameraCount;
+    uint32 mFilmIterations; // Iterations accumulated in the framebuffer since the last clear
+    float mAdaptiveError;
     uint32 mCurrentTechniqueVariant;
+    size_t mShadowRaysPerHit;
 
     bool mIsTrace;
     bool mIsDebug;
     DebugMode mDebugMode;
     bool mAcquireStats;
+    Statistics mLoadStatistics; // Phases of loading and compiling
+    Statistics mStatistics;
     std::vector<std::string> mAOVs;
+    std::vector<float> mRayBatchScratch; // Used to convert array of structures to structure of arrays
+    std::vector<float> mCameraViews;     // Packed views of all cameras given to the driver
+
+    bool mHasDenoiser;
+    Denoiser mDenoiser;
+    std::vector<float> mDenoisedFramebuffer;
 
     TechniqueVariantSelector mTechniqueVariantSelector;
     std::vector<TechniqueVariant> mTechniqueVariants;
@@ -1,7 +1,34 @@
 #include "Statistics.h"
+#include <algorithm>
+#include <iomanip>
+#include <limits>
 #include <sstream>
 
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
 namespace IG {
+// Short human readable representation of a duration given in nanoseconds
+inline static std::string formatNS(uint64 ns)
+{
+    if (ns < 1000)
+        return std::to_string(ns) + "ns";
+    else if (ns < 1000000)
+        return std::to_string(ns / 1000) + "us";
+    else if (ns < 1000000000)
+        return std::to_string(ns / 1000000) + "ms";
+    else
+        return std::to_string(ns / 1000000000) + "s";
+}
+
+// Fixed point representation, which does not change the formatting state of the stream it is written to
+inline static std::string formatFixed(double value, int precision)
+{
+    std::stringstream stream;
+    stream << std::fixed << std::setprecision(precision) << value;
+    return stream.str();
+}
+
 void Statistics::beginShaderLaunch(ShaderType type, size_t id)
 {
     ShaderStats* stats = getStats(type, id);
@@ -9,48 +36,131 @@ void Statistics::beginShaderLaunch(ShaderType type, size_t id)
     stats->count++;
 }
 
-void Statistics::endShaderLaunch(ShaderType type, size_t id)
+inline static size_t histogramBucket(uint64 elapsedNS)
 {
-    ShaderStats* stats = getStats(type, id);
-    stats->elapsedMS += stats->timer.stopMS();
+    size_t bucket = 0;
+    while (elapsedNS > 1 && bucket < Statistics::HistogramBucketCount - 1) {
+        elapsedNS >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void Statistics::endShaderLaunch(ShaderType type, size_t id, size_t workload)
+{
+    ShaderStats* stats     = getStats(type, id);
+    const uint64 elapsedNS = std::chrono::duration_cast<std::chrono::nanoseconds>(stats->timer.stop()).count();
+    stats->elapsedNS += elapsedNS;
+    stats->workload += workload;
+    stats->histogram[histogramBucket(elapsedNS)]++;
+
+    if (type == ShaderType::Device)
+        mIterationTimes.push_back(elapsedNS);
+
+    if (mRecordTimeline) {
+        const uint64 end = timestampNS();
+        mTimeline.push_back(TimelineEvent{ type, (uint32)id, mThread, end - elapsedNS, elapsedNS });
+    }
+}
+
+void Statistics::addPhase(const std::string& name, uint64 startNS, uint64 durationNS)
+{
+    mPhases.push_back(PhaseTiming{ name, startNS, durationNS });
+}
+
+uint64 Statistics::timestampNS()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+void Statistics::addSection(SectionType type, uint64 elapsedUS)
+{
+    mSectionTimes[(size_t)type] += elapsedUS;
+}
+
+void Statistics::increase(Quantity quantity, uint64 value)
+{
+    mQuantities[(size_t)quantity] += value;
+}
+
+void Statistics::addBounceRays(size_t bounce, uint64 count)
+{
+    if (mRaysPerBounce.size() <= bounce)
+        mRaysPerBounce.resize(bounce + 1, 0);
+    mRaysPerBounce[bounce] += count;
 }
 
 void Statistics::add(const Statistics& other)
 {
     const auto addStats = [](ShaderStats& a, const ShaderStats& b) {
-        a.elapsedMS += b.elapsedMS;
+        a.elapsedNS += b.elapsedNS;
         a.count += b.count;
+        a.workload += b.workload;
+        for (size_t i = 0; i < a.histogram.size(); ++i)
+            a.histogram[i] += b.histogram[i];
     };
 
     addStats(mDeviceStats, other.mDeviceStats);
     addStats(mRayGenerationStats, other.mRayGenerationStats);
     addStats(mMissStats, other.mMissStats);
-    for (const auto& pair : other.mHitStats)
-        addStats(mHitStats[pair.first], pair.second);
+    if (mHitStats.size() < other.mHitStats.size())
+        mHitStats.resize(other.mHitStats.size());
+    for (size_t i = 0; i < other.mHitStats.size(); ++i)
+        addStats(mHitStats[i], other.mHitStats[i]);
     addStats(mAdvancedShadowHitStats, other.mAdvancedShadowHitStats);
     addStats(mAdvancedShadowMissStats, other.mAdvancedShadowMissStats);
+
+    for (size_t i = 0; i < mSectionTimes.size(); ++i)
+        mSectionTimes[i] += other.mSectionTimes[i];
+    for (size_t i = 0; i < mQuantities.size(); ++i)
+        mQuantities[i] += other.mQuantities[i];
+    for (size_t i = 0; i < other.mRaysPerBounce.size(); ++i)
+        addBounceRays(i, other.mRaysPerBounce[i]);
+
+    mIterationTimes.insert(mIterationTimes.end(), other.mIterationTimes.begin(), other.mIterationTimes.end());
+    mPhases.insert(mPhases.end(), other.mPhases.begin(), other.mPhases.end());
+    mTimeline.insert(mTimeline.end(), other.mTimeline.begin(), other.mTimeline.end());
 }
 
 std::string Statistics::dump(size_t iter, bool verbose) const
 {
-    const auto dumpInline = [=](size_t count, size_t elapsedMS) {
+    const auto dumpInline = [=](uint64 count, uint64 elapsedNS, uint64 workload) {
         std::stringstream bstream;
-        bstream << elapsedMS << "ms [" << count << "]";
+        bstream << formatFixed(elapsedNS / 1e6, 3) << "ms [" << count << "]";
         if (iter != 0)
-            bstream << " | " << elapsedMS / iter << "ms [" << count / iter << "] per Iteration";
+            bstream << " | " << formatFixed(elapsedNS / (1e6 * iter), 3) << "ms [" << count / iter << "] per Iteration";
+        if (workload != 0)
+            bstream << " | " << formatFixed(elapsedNS / (double)workload, 1) << "ns/ray";
         return bstream.str();
     };
 
     const auto dumpStats = [=](const ShaderStats& stats) {
-        return dumpInline(stats.count, stats.elapsedMS);
+        return dumpInline(stats.count, stats.elapsedNS, stats.workload);
+    };
+
+    // Only buckets in between the first and last non-empty bucket are shown
+    const auto dumpHistogram = [](const ShaderStats& stats) {
+        size_t first = 0;
+        size_t last  = stats.histogram.size();
+        while (first < last && stats.histogram[first] == 0)
+            ++first;
+        while (last > first && stats.histogram[last - 1] == 0)
+            --last;
+
+        std::stringstream bstream;
+        for (size_t i = first; i < last; ++i)
+            bstream << " <" << formatNS(uint64(1) << (i + 1)) << ":" << stats.histogram[i];
+        return bstream.str();
     };
 
     // Get all hits information
-    size_t hitsCount = 0;
-    size_t hitsMS    = 0;
-    for (const auto& pair : mHitStats) {
-        hitsCount += pair.second.count;
-        hitsMS += pair.second.elapsedMS;
+    uint64 hitsCount    = 0;
+    uint64 hitsNS       = 0;
+    uint64 hitsWorkload = 0;
+    for (const auto& stats : mHitStats) {
+        hitsCount += stats.count;
+        hitsNS += stats.elapsedNS;
+        hitsWorkload += stats.workload;
     }
 
     // Dump
@@ -60,11 +170,15 @@ std::string Statistics::dump(size_t iter, bool verbose) const
            << "    Device>        " << dumpStats(mDeviceStats) << std::endl
            << "    RayGeneration> " << dumpStats(mRayGenerationStats) << std::endl
            << "    Miss>          " << dumpStats(mMissStats) << std::endl
-           << "    Hits>          " << dumpInline(hitsCount, hitsMS) << std::endl;
+           << "    Hits>          " << dumpInline(hitsCount, hitsNS, hitsWorkload) << std::endl;
 
     if (verbose) {
-        for (const auto& pair : mHitStats)
-            stream << "      @" << pair.first << " " << dumpStats(pair.second) << std::endl;
+        for (size_t id = 0; id < mHitStats.size(); ++id) {
+            if (mHitStats[id].count == 0)
+                continue;
+            stream << "      @" << id << " " << dumpStats(mHitStats[id]) << std::endl
+                   << "         Latency>" << dumpHistogram(mHitStats[id]) << std::endl;
+        }
     }
 
     if (mAdvancedShadowHitStats.count > 0 || mAdvancedShadowMissStats.count > 0) {
@@ -73,9 +187,218 @@ std::string Statistics::dump(size_t iter, bool verbose) const
                << "      Hits> " << dumpStats(mAdvancedShadowHitStats) << std::endl;
     }
 
+    // Only available if the device collects them
+    const uint64 totalUS = sectionTimeUS(SectionType::Total);
+    if (totalUS > 0) {
+        const auto dumpSection = [=](uint64 elapsedUS, uint64 rays) {
+            std::stringstream bstream;
+            bstream << elapsedUS / 1000 << "ms (" << formatFixed(100.0 * elapsedUS / totalUS, 1) << "%)";
+            if (rays > 0 && elapsedUS > 0)
+                bstream << " | " << formatFixed(rays / (double)elapsedUS, 2) << " Mrays/s";
+            return bstream.str();
+        };
+
+        const uint64 cameraRays = this->cameraRays();
+        const uint64 bounceRays = quantity(Quantity::PrimaryRays) - cameraRays;
+        const uint64 otherUS    = totalUS
+                               - std::min(totalUS, sectionTimeUS(SectionType::Primary) + sectionTimeUS(SectionType::Bounces)
+                                                       + sectionTimeUS(SectionType::Shadow) + sectionTimeUS(SectionType::Shading));
+
+        stream << "  Trace (summed over all threads):" << std::endl
+               << "    Primary>       " << dumpSection(sectionTimeUS(SectionType::Primary), cameraRays) << std::endl
+               << "    Bounces>       " << dumpSection(sectionTimeUS(SectionType::Bounces), bounceRays) << std::endl
+               << "    Shadow>        " << dumpSection(sectionTimeUS(SectionType::Shadow), quantity(Quantity::SecondaryRays)) << std::endl
+               << "    Shading>       " << dumpSection(sectionTimeUS(SectionType::Shading), quantity(Quantity::PrimaryRays)) << std::endl
+               << "    Others>        " << dumpSection(otherUS, 0) << std::endl
+               << "    Total>         " << dumpSection(totalUS, quantity(Quantity::PrimaryRays) + quantity(Quantity::SecondaryRays)) << std::endl
+               << "    Rays>          " << quantity(Quantity::PrimaryRays) << " primary, " << quantity(Quantity::SecondaryRays) << " secondary" << std::endl;
+
+        if (cameraRays > 0)
+            stream << "    PerSample>     " << formatFixed(averagePathLength(), 2) << " path segments, " << formatFixed(raysPerSample(), 2) << " rays" << std::endl;
+
+        if (quantity(Quantity::ShadingLanes) > 0)
+            stream << "    ActiveLanes>   " << formatFixed(100.0 * quantity(Quantity::ActiveLanes) / quantity(Quantity::ShadingLanes), 1) << "%" << std::endl;
+
+        if (verbose) {
+            stream << "    RaysPerBounce>" << std::endl;
+            for (size_t i = 0; i < mRaysPerBounce.size(); ++i)
+                stream << "      @" << i << " " << mRaysPerBounce[i] << std::endl;
+        }
+    }
+
     return stream.str();
 }
 
+static const char* shaderTypeName(ShaderType type)
+{
+    switch (type) {
+    default:
+    case ShaderType::Device:
+        return "Device";
+    case ShaderType::RayGeneration:
+        return "RayGeneration";
+    case ShaderType::Hit:
+        return "Hit";
+    case ShaderType::Miss:
+        return "Miss";
+    case ShaderType::AdvancedShadowHit:
+        return "AdvancedShadowHit";
+    case ShaderType::AdvancedShadowMiss:
+        return "AdvancedShadowMiss";
+    }
+}
+
+using JSONWriter = rapidjson::Writer<rapidjson::StringBuffer>;
+
+static void writeShaderStatsJSON(JSONWriter& writer, const Statistics::ShaderStats& stats)
+{
+    writer.StartObject();
+    writer.Key("elapsed_ns");
+    writer.Uint64(stats.elapsedNS);
+    writer.Key("count");
+    writer.Uint64(stats.count);
+    writer.Key("workload");
+    writer.Uint64(stats.workload);
+    writer.Key("ns_per_ray");
+    writer.Double(stats.nsPerRay());
+    writer.Key("histogram");
+    writer.StartArray();
+    for (uint64 bucket : stats.histogram)
+        writer.Uint64(bucket);
+    writer.EndArray();
+    writer.EndObject();
+}
+
+std::string Statistics::dumpAsJSON(size_t iter) const
+{
+    rapidjson::StringBuffer buffer;
+    JSONWriter writer(buffer);
+
+    writer.StartObject();
+    writer.Key("iterations");
+    writer.Uint64(iter);
+
+    writer.Key("shaders");
+    writer.StartObject();
+    writer.Key("device");
+    writeShaderStatsJSON(writer, mDeviceStats);
+    writer.Key("ray_generation");
+    writeShaderStatsJSON(writer, mRayGenerationStats);
+    writer.Key("miss");
+    writeShaderStatsJSON(writer, mMissStats);
+    writer.Key("hits");
+    writer.StartArray();
+    for (const auto& stats : mHitStats)
+        writeShaderStatsJSON(writer, stats);
+    writer.EndArray();
+    writer.Key("advanced_shadow_hit");
+    writeShaderStatsJSON(writer, mAdvancedShadowHitStats);
+    writer.Key("advanced_shadow_miss");
+    writeShaderStatsJSON(writer, mAdvancedShadowMissStats);
+    writer.EndObject();
+
+    writer.Key("trace");
+    writer.StartObject();
+    const char* sectionNames[] = { "primary_us", "bounces_us", "shadow_us", "shading_us", "total_us" };
+    static_assert(sizeof(sectionNames) / sizeof(sectionNames[0]) == (size_t)SectionType::_COUNT, "Expected all sections to be named");
+    for (size_t i = 0; i < mSectionTimes.size(); ++i) {
+        writer.Key(sectionNames[i]);
+        writer.Uint64(mSectionTimes[i]);
+    }
+    const char* quantityNames[] = { "primary_rays", "secondary_rays", "shading_lanes", "active_lanes" };
+    static_assert(sizeof(quantityNames) / sizeof(quantityNames[0]) == (size_t)Quantity::_COUNT, "Expected all quantities to be named");
+    for (size_t i = 0; i < mQuantities.size(); ++i) {
+        writer.Key(quantityNames[i]);
+        writer.Uint64(mQuantities[i]);
+    }
+    writer.Key("rays_per_bounce");
+    writer.StartArray();
+    for (uint64 rays : mRaysPerBounce)
+        writer.Uint64(rays);
+    writer.EndArray();
+    writer.Key("avg_path_length");
+    writer.Double(averagePathLength());
+    writer.Key("rays_per_sample");
+    writer.Double(raysPerSample());
+    writer.EndObject();
+
+    writer.Key("iteration_times_ns");
+    writer.StartArray();
+    for (uint64 elapsed : mIterationTimes)
+        writer.Uint64(elapsed);
+    writer.EndArray();
+
+    writer.Key("phases");
+    writer.StartArray();
+    for (const auto& phase : mPhases) {
+        writer.StartObject();
+        writer.Key("name");
+        writer.String(phase.Name.c_str());
+        writer.Key("start_ns");
+        writer.Uint64(phase.StartNS);
+        writer.Key("duration_ns");
+        writer.Uint64(phase.DurationNS);
+        writer.EndObject();
+    }
+    writer.EndArray();
+
+    writer.EndObject();
+    return buffer.GetString();
+}
+
+std::string Statistics::dumpAsChromeTrace() const
+{
+    // All timestamps are given relative to the earliest entry
+    uint64 origin = std::numeric_limits<uint64>::max();
+    for (const auto& phase : mPhases)
+        origin = std::min(origin, phase.StartNS);
+    for (const auto& event : mTimeline)
+        origin = std::min(origin, event.StartNS);
+
+    rapidjson::StringBuffer buffer;
+    JSONWriter writer(buffer);
+
+    const auto writeEvent = [&](const std::string& name, const char* category, uint32 thread, uint64 startNS, uint64 durationNS) {
+        writer.StartObject();
+        writer.Key("name");
+        writer.String(name.c_str());
+        writer.Key("cat");
+        writer.String(category);
+        writer.Key("ph");
+        writer.String("X");
+        writer.Key("ts");
+        writer.Double((startNS - origin) / 1000.0);
+        writer.Key("dur");
+        writer.Double(durationNS / 1000.0);
+        writer.Key("pid");
+        writer.Uint(0);
+        writer.Key("tid");
+        writer.Uint(thread);
+        writer.EndObject();
+    };
+
+    writer.StartObject();
+    writer.Key("displayTimeUnit");
+    writer.String("ns");
+    writer.Key("traceEvents");
+    writer.StartArray();
+
+    // Phases are put on their own track, render threads start at 1
+    for (const auto& phase : mPhases)
+        writeEvent(phase.Name, "phase", 0, phase.StartNS, phase.DurationNS);
+
+    for (const auto& event : mTimeline) {
+        if (event.Type == ShaderType::Hit)
+            writeEvent(std::string(shaderTypeName(event.Type)) + " @" + std::to_string(event.ID), "shader", event.Thread + 1, event.StartNS, event.DurationNS);
+        else
+            writeEvent(shaderTypeName(event.Type), "shader", event.Thread + 1, event.StartNS, event.DurationNS);
+    }
+
+    writer.EndArray();
+    writer.EndObject();
+    return buffer.GetString();
+}
+
 Statistics::ShaderStats* Statistics::getStats(ShaderType type, size_t id)
 {
     switch (type) {
@@ -87,6 +410,8 @@ Statistics::ShaderStats* Statistics::getStats(ShaderType type, size_t id)
     case ShaderType::Miss:
         return &mMissStats;
     case ShaderType::Hit:
+        if (id >= mHitStats.size())
+            mHitStats.resize(id + 1);
         return &mHitStats[id];
     case ShaderType::AdvancedShadowHit:
         return &mAdvancedShadowHitStats;
@@ -94,4 +419,24 @@ Statistics::ShaderStats* Statistics::getStats(ShaderType type, size_t id)
         return &mAdvancedShadowMissStats;
     }
 }
+
+const Statistics::ShaderStats& Statistics::shaderStats(ShaderType type, size_t id) const
+{
+    static const ShaderStats sEmpty;
+    switch (type) {
+    default:
+    case ShaderType::Device:
+        return mDeviceStats;
+    case ShaderType::RayGeneration:
+        return mRayGenerationStats;
+    case ShaderType::Miss:
+        return mMissStats;
+    case ShaderType::Hit:
+        return id < mHitStats.size() ? mHitStats[id] : sEmpty;
+    case ShaderType::AdvancedShadowHit:
+        return mAdvancedShadowHitStats;
+    case ShaderType::AdvancedShadowMiss:
+        return mAdvancedShadowMissStats;
+    }
+}
 } // namespace IG
\ No newline at end of file
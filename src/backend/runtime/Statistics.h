@@ -1,8 +1,10 @@
 #pragma once
 
-#include <map>
+#include <array>
 #include <string>
+#include <vector>
 
+#include "IG_Config.h"
 #include "Timer.h"
 
 namespace IG {
@@ -15,6 +17,41 @@ enum class ShaderType {
     AdvancedShadowMiss,
 };
 
+// Timed sections of the device trace loop. Has to be in sync with driver.art
+enum class SectionType {
+    Primary = 0, // Traversal of the first wavefront (camera rays)
+    Bounces,     // Traversal of all following wavefronts
+    Shadow,      // Traversal of secondary rays
+    Shading,     // Hit and miss shading
+    Total,       // The whole trace loop
+    _COUNT
+};
+
+// Counted quantities of the device trace loop. Has to be in sync with driver.art
+enum class Quantity {
+    PrimaryRays = 0, // Traced primary rays, including bounces
+    SecondaryRays,   // Traced secondary rays
+    ShadingLanes,    // Vector lanes used while shading
+    ActiveLanes,     // Vector lanes with an actual ray while shading
+    _COUNT
+};
+
+// Timing of a single named phase outside the render loop, e.g., loading or compiling
+struct PhaseTiming {
+    std::string Name;
+    uint64 StartNS;
+    uint64 DurationNS;
+};
+
+// A single shader launch on the timeline
+struct TimelineEvent {
+    ShaderType Type;
+    uint32 ID;
+    uint32 Thread;
+    uint64 StartNS;
+    uint64 DurationNS;
+};
+
 class Statistics {
 public:
     inline void reset()
@@ -22,27 +59,84 @@ public:
         *this = Statistics();
     }
 
+    // Number of logarithmic (base 2) latency buckets in nanoseconds, the last bucket contains all launches above 2^(N-1) ns
+    static constexpr size_t HistogramBucketCount = 32;
+
+    struct ShaderStats {
+        Timer timer;
+        uint64 elapsedNS = 0;
+        uint64 count     = 0; // Number of launches
+        uint64 workload  = 0; // Number of rays processed by all launches
+
+        std::array<uint64, HistogramBucketCount> histogram = {};
+
+        inline double nsPerRay() const { return workload > 0 ? elapsedNS / (double)workload : 0.0; }
+    };
+
     void beginShaderLaunch(ShaderType type, size_t id);
-    void endShaderLaunch(ShaderType type, size_t id);
+    void endShaderLaunch(ShaderType type, size_t id, size_t workload);
+
+    void addSection(SectionType type, uint64 elapsedUS);
+    void increase(Quantity quantity, uint64 value);
+    // Rays traced in the given wavefront, with 0 being the camera rays
+    void addBounceRays(size_t bounce, uint64 count);
+
+    void addPhase(const std::string& name, uint64 startNS, uint64 durationNS);
+
+    // Record every shader launch of this (per thread) statistic into the timeline
+    inline void enableTimeline(uint32 thread)
+    {
+        mRecordTimeline = true;
+        mThread         = thread;
+    }
 
     void add(const Statistics& other);
 
+    // Timestamp in nanoseconds used for all phases and timeline events
+    static uint64 timestampNS();
+
+    // Structured access to the collected data. Sections are summed over all threads
+    inline uint64 sectionTimeUS(SectionType type) const { return mSectionTimes[(size_t)type]; }
+    inline uint64 quantity(Quantity quantity) const { return mQuantities[(size_t)quantity]; }
+    inline const std::vector<uint64>& raysPerBounce() const { return mRaysPerBounce; }
+    inline uint64 cameraRays() const { return mRaysPerBounce.empty() ? 0 : mRaysPerBounce.front(); }
+    // Average number of path segments (camera and bounce rays) per camera ray. Zero if rays per bounce are not collected
+    inline double averagePathLength() const { return cameraRays() > 0 ? quantity(Quantity::PrimaryRays) / (double)cameraRays() : 0.0; }
+    // Average number of all traced rays, including shadow rays, per camera ray. Zero if rays per bounce are not collected
+    inline double raysPerSample() const { return cameraRays() > 0 ? (quantity(Quantity::PrimaryRays) + quantity(Quantity::SecondaryRays)) / (double)cameraRays() : 0.0; }
+    // Hit shaders are indexed by entity id. The id is ignored for all other types
+    const ShaderStats& shaderStats(ShaderType type, size_t id = 0) const;
+    inline size_t hitShaderCount() const { return mHitStats.size(); }
+    // Duration of each device launch, usually one per iteration
+    inline const std::vector<uint64>& iterationTimesNS() const { return mIterationTimes; }
+    inline const std::vector<PhaseTiming>& phases() const { return mPhases; }
+    inline const std::vector<TimelineEvent>& timeline() const { return mTimeline; }
+
     std::string dump(size_t iter, bool verbose) const;
+    // Machine readable representation of all statistics
+    std::string dumpAsJSON(size_t iter) const;
+    // Phases and timeline in the chrome trace event format (chrome://tracing)
+    std::string dumpAsChromeTrace() const;
 
 private:
-    struct ShaderStats {
-        Timer timer;
-        size_t elapsedMS = 0;
-        size_t count     = 0;
-    };
-
     ShaderStats* getStats(ShaderType type, size_t id);
 
     ShaderStats mDeviceStats;
     ShaderStats mRayGenerationStats;
     ShaderStats mMissStats;
-    std::map<size_t, ShaderStats> mHitStats;
+    std::vector<ShaderStats> mHitStats; // Flat array indexed by entity id, grows on demand
     ShaderStats mAdvancedShadowHitStats;
     ShaderStats mAdvancedShadowMissStats;
+
+    std::array<uint64, (size_t)SectionType::_COUNT> mSectionTimes = {};
+    std::array<uint64, (size_t)Quantity::_COUNT> mQuantities      = {};
+    std::vector<uint64> mRaysPerBounce;
+
+    std::vector<uint64> mIterationTimes;
+    std::vector<PhaseTiming> mPhases;
+
+    bool mRecordTimeline = false;
+    uint32 mThread       = 0;
+    std::vector<TimelineEvent> mTimeline;
 };
 } // namespace IG
\ No newline at end of file
@@ -6,7 +6,7 @@
 
 namespace IG {
 struct SceneDatabase;
-struct Ray;
+struct RayBatch;
 class Statistics;
 } // namespace IG
 
@@ -16,7 +16,11 @@ struct DriverSetupSettings {
     IG::uint32 framebuffer_height = 0;
     IG::SceneDatabase* database   = nullptr;
     bool acquire_stats            = false;
+    bool record_timeline          = false;
     size_t aov_count              = false;
+    float adaptive_error          = 0; // Target relative error of adaptive sampling. Zero disables it. Only supported by CPU drivers
+    size_t adaptive_aov           = 0; // AOV containing the effective samples per pixel if adaptive sampling is enabled
+    size_t shadow_rays_per_hit    = 1; // Size of the secondary streams relative to the primary streams
 };
 
 struct DriverRenderSettings {
@@ -28,7 +32,10 @@ struct DriverRenderSettings {
     float height;
     float tmin;
     float tmax;
-    const IG::Ray* rays; // If non-null, width contains the number of rays and height is set to 1
+    const IG::RayBatch* rays; // If non-null, a new list is given and the film is resized to its count. Width and height are informative only. Trace drivers keep using the last list otherwise
+    const float* camera_views; // If non-null, camera_count packed views (eye, dir, up, right, width, height, tmin, tmax) rendered into vertically stacked films
+    IG::uint32 camera_count;
+    IG::uint32 film_iterations; // Iterations already accumulated in the framebuffer, used by adaptive sampling
     IG::uint32 device;
     IG::uint32 spi;
     IG::uint32 max_path_length;
@@ -41,7 +48,9 @@ using DriverSetupFunction            = void (*)(const DriverSetupSettings*);
 using DriverSetShaderSet             = void (*)(const IG::TechniqueVariantShaderSet& shaderSet);
 using DriverGetFramebufferFunction   = const float* (*)(int);
 using DriverClearFramebufferFunction = void (*)(int);
+using DriverSetFramebufferFunction   = void (*)(int, const float*);
 using DriverGetStatisticsFunction    = const IG::Statistics* (*)();
+using DriverGetAdaptiveDataFunction  = float* (*)(size_t*); // Returns the per pixel statistics of adaptive sampling and their count, or null if disabled
 
 struct DriverInterface {
     IG::uint32 MajorVersion;
@@ -54,5 +63,7 @@ struct DriverInterface {
     DriverSetShaderSet SetShaderSetFunction;
     DriverGetFramebufferFunction GetFramebufferFunction;
     DriverClearFramebufferFunction ClearFramebufferFunction;
+    DriverSetFramebufferFunction SetFramebufferFunction;
     DriverGetStatisticsFunction GetStatisticsFunction;
+    DriverGetAdaptiveDataFunction GetAdaptiveDataFunction;
 };
\ No newline at end of file
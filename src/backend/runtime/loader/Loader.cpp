@@ -10,9 +10,20 @@
 #include "shader/MissShader.h"
 #include "shader/RayGenerationShader.h"
 
+#include <algorithm>
 #include <chrono>
 
 namespace IG {
+// Track the duration of the given loading phase
+template <typename Func>
+inline static bool timePhase(LoaderResult& result, const std::string& name, Func func)
+{
+    const uint64 start = Statistics::timestampNS();
+    const bool ok      = func();
+    result.Phases.push_back(PhaseTiming{ name, start, Statistics::timestampNS() - start });
+    return ok;
+}
+
 bool Loader::load(const LoaderOptions& opts, LoaderResult& result)
 {
     const auto start1 = std::chrono::high_resolution_clock::now();
@@ -23,14 +34,18 @@ bool Loader::load(const LoaderOptions& opts, LoaderResult& result)
     ctx.EnablePadding       = doesTargetRequirePadding(ctx.Target);
     ctx.Scene               = opts.Scene;
     ctx.CameraType          = opts.CameraType;
+    ctx.CameraCount         = opts.CameraCount;
+    ctx.PixelSamplerType    = opts.PixelSamplerType;
     ctx.TechniqueType       = opts.TechniqueType;
     ctx.SamplesPerIteration = opts.SamplesPerIteration;
+    ctx.Denoise             = opts.Denoise;
+    ctx.CacheDir            = opts.CacheDir;
 
     // Load content
-    if (!LoaderShape::load(ctx, result))
+    if (!timePhase(result, "LoaderShape", [&]() { return LoaderShape::load(ctx, result); }))
         return false;
 
-    if (!LoaderEntity::load(ctx, result))
+    if (!timePhase(result, "LoaderEntity", [&]() { return LoaderEntity::load(ctx, result); }))
         return false;
 
     ctx.Database      = &result.Database;
@@ -38,14 +53,25 @@ bool Loader::load(const LoaderOptions& opts, LoaderResult& result)
 
     LoaderLight::setupAreaLights(ctx);
 
+    const auto& generators = ctx.TechniqueInfo.OverrideCameraGenerator;
+    result.OverridesCamera = std::any_of(generators.begin(), generators.end(), [](const TechniqueCameraGenerator& gen) { return gen != nullptr; });
+
+    // Overridden camera generators only know a single view
+    if (ctx.CameraCount > 1 && result.OverridesCamera) {
+        IG_LOG(L_WARNING) << "Technique overrides the camera, multiple camera views are not supported. Rendering a single view" << std::endl;
+        ctx.CameraCount = 1;
+    }
+
+    const uint64 startShaders = Statistics::timestampNS();
     result.TechniqueVariants.resize(ctx.TechniqueInfo.VariantCount);
     for (uint32 i = 0; i < ctx.TechniqueInfo.VariantCount; ++i) {
         auto& variant               = result.TechniqueVariants[i];
         ctx.CurrentTechniqueVariant = i;
 
         // Generate Ray Generation Shader
-        if (ctx.TechniqueInfo.OverrideCameraGenerator[ctx.CurrentTechniqueVariant])
+        if (ctx.TechniqueInfo.OverrideCameraGenerator[ctx.CurrentTechniqueVariant]) {
             variant.RayGenerationShader = ctx.TechniqueInfo.OverrideCameraGenerator[ctx.CurrentTechniqueVariant](ctx);
+        }
         else
             variant.RayGenerationShader = RayGenerationShader::setup(ctx);
         if (variant.RayGenerationShader.empty())
@@ -70,9 +96,13 @@ bool Loader::load(const LoaderOptions& opts, LoaderResult& result)
             variant.AdvancedShadowMissShader = AdvancedShadowShader::setup(false, ctx);
         }
     }
+    result.Phases.push_back(PhaseTiming{ "ShaderGeneration", startShaders, Statistics::timestampNS() - startShaders });
 
     result.Database.SceneRadius = ctx.Environment.SceneDiameter / 2.0f;
     result.AOVs                 = ctx.TechniqueInfo.EnabledAOVs;
+    result.ShadowRaysPerHit     = ctx.TechniqueInfo.ShadowRaysPerHit;
+    result.CameraCount          = ctx.CameraCount;
+    result.VariantSelector      = ctx.TechniqueInfo.VariantSelector;
 
     IG_LOG(L_DEBUG) << "Loading scene took " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start1).count() / 1000.0f << " seconds" << std::endl;
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Parser.h"
+#include "Statistics.h"
 #include "Target.h"
 #include "TechniqueVariant.h"
 #include "table/SceneDatabase.h"
@@ -15,14 +16,23 @@ struct LoaderOptions {
     std::string CameraType;
     std::string TechniqueType;
     size_t SamplesPerIteration;
+    size_t CameraCount = 1; // Number of camera views rendered in a single pass
+    std::string PixelSamplerType;
+    bool Denoise                   = false;  // Enable the aovs used by the denoiser
+    std::filesystem::path CacheDir = "data"; // Directory for generated data reused across runs, e.g., sky textures
 };
 
 struct LoaderResult {
     SceneDatabase Database;
     std::vector<std::string> AOVs;
+    size_t ShadowRaysPerHit = 1;
+    size_t CameraCount      = 1;     // Might be less than requested, if the technique does not support multiple views
+    bool OverridesCamera    = false; // True if the technique generates its own rays, e.g., to splat into arbitrary pixels of the film
 
     std::vector<TechniqueVariant> TechniqueVariants;
     TechniqueVariantSelector VariantSelector;
+
+    std::vector<PhaseTiming> Phases; // Timings of the individual loading phases
 };
 
 class Loader {
@@ -37,8 +37,12 @@ struct LoaderContext {
     std::unordered_map<std::string, uint32> Images; // Image to Buffer
 
     std::string CameraType;
+    size_t CameraCount;
+    std::string PixelSamplerType;
     std::string TechniqueType;
     IG::TechniqueInfo TechniqueInfo;
+    bool Denoise;
+    std::filesystem::path CacheDir; // Generated data, e.g., sky textures, is stored here and reused across runs
 
     uint32 CurrentTechniqueVariant;
 
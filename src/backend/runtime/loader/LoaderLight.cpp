@@ -1,4 +1,5 @@
 #include "LoaderLight.h"
+#include "CDF.h"
 #include "Loader.h"
 #include "LoaderTexture.h"
 #include "Logger.h"
@@ -9,6 +10,7 @@
 #include "skysun/SunLocation.h"
 
 #include <chrono>
+#include <iomanip>
 
 // TODO: Make use of the ShadingTree!!
 namespace IG {
@@ -39,17 +41,115 @@ static ElevationAzimuth extractEA(const std::shared_ptr<Parser::Object>& obj)
     }
 }
 
-static std::string setup_sky(const std::string& name, const std::shared_ptr<Parser::Object>& light)
+// Generates the file at the given path with the given function, unless it already exists.
+// The file is written under a temporary name first, such that concurrent runs sharing the cache never see a partial file
+template <typename Func>
+static bool generate_cached(const std::filesystem::path& path, Func func)
+{
+    if (std::filesystem::exists(path)) {
+        IG_LOG(L_DEBUG) << "Using cached " << path << std::endl;
+        return true;
+    }
+
+    std::error_code ec;
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path(), ec); // Make sure this directory exists
+
+    const auto stamp = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    const auto tmp   = path.parent_path() / (path.stem().string() + "_" + std::to_string(stamp) + path.extension().string());
+    if (!func(tmp))
+        return false;
+
+    std::filesystem::rename(tmp, path, ec);
+    if (ec)
+        std::filesystem::remove(tmp, ec); // Another run was faster
+    return std::filesystem::exists(path);
+}
+
+// FNV-1a, which in contrast to std::hash is stable across platforms and runs
+static uint64 hash_bytes(const void* data, size_t size, uint64 hash = 14695981039346656037ull)
+{
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= reinterpret_cast<const uint8*>(data)[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static std::string cache_key(uint64 hash)
+{
+    std::stringstream stream;
+    stream << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return stream.str();
+}
+
+// The generated sky only depends on these parameters, which allows to share it between scenes and runs
+static std::string sky_cache_key(const Vector3f& ground, float turbidity, const ElevationAzimuth& ea, size_t res_az, size_t res_el)
+{
+    const float params[] = { ground.x(), ground.y(), ground.z(), turbidity, ea.Elevation, ea.Azimuth, (float)res_az, (float)res_el };
+    return cache_key(hash_bytes(params, sizeof(params)));
+}
+
+// Has to be increased whenever CDF::computeForImage changes its result, such that stale cached files are not used
+constexpr uint32 IMAGE_CDF_CACHE_VERSION = 2;
+
+// The cdf of an image only changes with the image file itself or the way it is mapped
+static std::string image_cdf_cache_key(const std::filesystem::path& image, bool flip_x, bool flip_y)
+{
+    std::error_code ec;
+    const std::string path = std::filesystem::absolute(image, ec).generic_u8string();
+    const auto mtime       = std::filesystem::last_write_time(image, ec).time_since_epoch().count();
+    const uint8 flags      = (flip_x ? 1 : 0) | (flip_y ? 2 : 0);
+
+    uint64 hash = hash_bytes(&IMAGE_CDF_CACHE_VERSION, sizeof(IMAGE_CDF_CACHE_VERSION));
+    hash        = hash_bytes(path.data(), path.size(), hash);
+    hash        = hash_bytes(&mtime, sizeof(mtime), hash);
+    hash        = hash_bytes(&flags, sizeof(flags), hash);
+    return cache_key(hash);
+}
+
+struct SkyTexture {
+    std::filesystem::path Texture;
+    std::filesystem::path CDF; // Empty if not available
+};
+
+static SkyTexture setup_sky(const std::shared_ptr<Parser::Object>& light, const LoaderContext& ctx)
 {
     auto ground    = light->property("ground").getVector3(Vector3f(0.8f, 0.8f, 0.8f));
     auto turbidity = light->property("turbidity").getNumber(3.0f);
     auto ea        = extractEA(light);
 
-    std::filesystem::create_directories("data/"); // Make sure this directory exists
-    std::string path = "data/skytex_" + ShaderUtils::escapeIdentifier(name) + ".exr";
-    SkyModel model(ground, ea, turbidity);
-    model.save(path);
-    return path;
+    const std::string key = sky_cache_key(ground, turbidity, ea, RES_AZ, RES_EL);
+
+    SkyTexture sky;
+    sky.Texture = ctx.CacheDir / ("skytex_" + key + ".exr");
+    if (!generate_cached(sky.Texture, [&](const std::filesystem::path& path) {
+            IG_LOG(L_DEBUG) << "Generating sky texture " << sky.Texture << std::endl;
+            return SkyModel(ground, ea, turbidity, RES_AZ, RES_EL).save(path);
+        })) {
+        IG_LOG(L_ERROR) << "Could not generate sky texture " << sky.Texture << std::endl;
+        return sky;
+    }
+
+    const auto cdf_path = ctx.CacheDir / ("skycdf_" + key + ".bin");
+    if (generate_cached(cdf_path, [&](const std::filesystem::path& path) {
+            size_t slice_size, marginal_size;
+            return CDF::computeForImage(sky.Texture, path, slice_size, marginal_size);
+        }))
+        sky.CDF = cdf_path;
+
+    return sky;
+}
+
+// Emits an environment light sampled proportional to the luminance of the texture, given by the cdf computed by CDF::computeForImage
+static void setup_env_importance(std::ostream& stream, const std::string& name, const std::string& tex_id, const std::filesystem::path& cdf_path,
+                                 size_t slice_size, size_t marginal_size, float phi_off, const LoaderContext& ctx)
+{
+    const std::string id = ShaderUtils::escapeIdentifier(name);
+
+    stream << "  let cdf_" << id << "   = make_cdf_2d(device.load_buffer(\"" << cdf_path.generic_string() << "\"), " << slice_size << ", " << marginal_size << ");" << std::endl
+           << "  let light_" << id << " = make_environment_light_textured_importance(" << ctx.Environment.SceneDiameter / 2
+           << ", " << tex_id << ", cdf_" << id << ", " << phi_off << ");" << std::endl;
 }
 
 static void light_point(std::ostream& stream, const std::string& name, const std::shared_ptr<Parser::Object>& light, const LoaderContext& ctx)
@@ -130,9 +230,10 @@ static void light_area(std::ostream& stream, const std::string& name, const std:
     uint32 shape_id     = ctx.Environment.ShapeIDs.at(entity.Shape);
     const auto shape    = ctx.Environment.Shapes[shape_id];
     size_t shape_offset = ctx.Database->ShapeTable.lookups()[shape_id].Offset;
+    uint32 shape_flags  = ctx.Database->ShapeTable.lookups()[shape_id].Flags;
 
     stream << "  let ae_" << ShaderUtils::escapeIdentifier(name) << " = make_shape_area_emitter(" << inline_entity(entity, shape_id)
-           << ", device.load_specific_shape(" << shape.FaceCount << ", " << shape.VertexCount << ", " << shape.NormalCount << ", " << shape.TexCount << ", " << shape_offset << ", dtb.shapes));" << std::endl
+           << ", device.load_specific_shape(" << shape.FaceCount << ", " << shape.VertexCount << ", " << shape.NormalCount << ", " << shape.TexCount << ", " << shape_flags << ", " << shape_offset << ", dtb.shapes));" << std::endl
            << "  let light_" << ShaderUtils::escapeIdentifier(name) << " = make_area_light(ae_" << ShaderUtils::escapeIdentifier(name) << ", "
            << ShaderUtils::inlineColor(radiance) << ");" << std::endl;
 }
@@ -166,12 +267,15 @@ static void light_sun(std::ostream& stream, const std::string& name, const std::
 
 static void light_sky(std::ostream& stream, const std::string& name, const std::shared_ptr<Parser::Object>& light, const LoaderContext& ctx)
 {
-    const std::string path = setup_sky(name, light);
-    const std::string id   = ShaderUtils::escapeIdentifier(name);
+    const auto sky       = setup_sky(light, ctx);
+    const std::string id = ShaderUtils::escapeIdentifier(name);
 
-    stream << "  let tex_" << id << "   = make_image_texture(make_repeat_border(), make_bilinear_filter(), device.load_image(\"" << path << "\"), false, false);" << std::endl
-           << "  let light_" << id << " = make_environment_light_textured(" << ctx.Environment.SceneDiameter / 2
-           << ", tex_" << id << ", 0, 0);" << std::endl;
+    stream << "  let tex_" << id << "   = make_image_texture(make_repeat_border(), make_bilinear_filter(), device.load_image(\"" << sky.Texture.generic_string() << "\"), false, false);" << std::endl;
+    if (!sky.CDF.empty())
+        setup_env_importance(stream, name, "tex_" + id, sky.CDF, RES_AZ + 1, RES_EL + 1, 0, ctx);
+    else
+        stream << "  let light_" << id << " = make_environment_light_textured(" << ctx.Environment.SceneDiameter / 2
+               << ", tex_" << id << ", 0, 0);" << std::endl;
 }
 
 static void light_cie_uniform(std::ostream& stream, const std::string& name, const std::shared_ptr<Parser::Object>& light, const LoaderContext& ctx)
@@ -262,9 +366,32 @@ static void light_env(std::ostream& stream, const std::string& name, const std::
         }
 
         ShadingTree tree;
-        stream << LoaderTexture::generate(tex_name, *tex, ctx, tree)
-               << "  let light_" << ShaderUtils::escapeIdentifier(name) << " = make_environment_light_textured(" << ctx.Environment.SceneDiameter / 2
-               << ", tex_" << ShaderUtils::escapeIdentifier(tex_name) << ", "
+        stream << LoaderTexture::generate(tex_name, *tex, ctx, tree);
+
+        // Importance sampling is only available for plain images mapping to the whole sphere
+        const std::string tex_id = "tex_" + ShaderUtils::escapeIdentifier(tex_name);
+        const bool is_image      = tex->pluginType() == "image" || tex->pluginType() == "bitmap";
+        const bool repeats       = tex->property("wrap_mode").getString("repeat") == "repeat";
+        if (is_image && repeats && theta_off == 0) {
+            const auto image  = ctx.handlePath(tex->property("filename").getString());
+            const bool flip_x = tex->property("flip_x").getBool(false);
+            const bool flip_y = tex->property("flip_y").getBool(false);
+
+            const auto cdf_path = ctx.CacheDir / ("envcdf_" + image_cdf_cache_key(image, flip_x, flip_y) + ".bin");
+
+            size_t slice_size, marginal_size;
+            if (generate_cached(cdf_path, [&](const std::filesystem::path& path) {
+                    IG_LOG(L_DEBUG) << "Generating environment cdf " << cdf_path << std::endl;
+                    return CDF::computeForImage(image, path, slice_size, marginal_size, flip_x, flip_y);
+                })
+                && CDF::loadSizes(cdf_path, slice_size, marginal_size)) {
+                setup_env_importance(stream, name, tex_id, cdf_path, slice_size, marginal_size, phi_off, ctx);
+                return;
+            }
+        }
+
+        stream << "  let light_" << ShaderUtils::escapeIdentifier(name) << " = make_environment_light_textured(" << ctx.Environment.SceneDiameter / 2
+               << ", " << tex_id << ", "
                << theta_off << ", " << phi_off << ");" << std::endl;
     } else {
         const Vector3f color = ctx.extractColor(*light, "radiance");
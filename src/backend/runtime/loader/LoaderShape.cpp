@@ -3,6 +3,7 @@
 
 #include "Logger.h"
 #include "bvh/TriBVHAdapter.h"
+#include "mesh/IgMeshFile.h"
 #include "mesh/MtsSerializedFile.h"
 #include "mesh/ObjFile.h"
 #include "mesh/PlyFile.h"
@@ -152,12 +153,12 @@ inline TriMesh setup_mesh_ply(const std::string& name, const Object& elem, const
     return trimesh;
 }
 
-inline TriMesh setup_mesh_mitsuba(const std::string& name, const Object& elem, const LoaderContext& ctx)
+inline TriMesh setup_mesh_mitsuba(const std::string& name, const Object& elem, const LoaderContext& ctx, mts::DictionaryCache& cache)
 {
     size_t shape_index  = elem.property("shape_index").getInteger(0);
     const auto filename = ctx.handlePath(elem.property("filename").getString());
     // IG_LOG(L_DEBUG) << "Shape '" << name << "': Trying to load serialized mitsuba file " << filename << std::endl;
-    auto trimesh = mts::load(filename, shape_index);
+    auto trimesh = mts::load(filename, shape_index, &cache);
     if (trimesh.vertices.empty()) {
         IG_LOG(L_WARNING) << "Shape '" << name << "': Can not load shape given by file " << filename << std::endl;
         return TriMesh();
@@ -165,14 +166,62 @@ inline TriMesh setup_mesh_mitsuba(const std::string& name, const Object& elem, c
     return trimesh;
 }
 
+inline bool setup_mesh_ig(const std::string& name, const Object& elem, const LoaderContext& ctx, uint32 bvhVariant, TriMesh& mesh, igm::MeshFile& raw)
+{
+    const auto filename = ctx.handlePath(elem.property("filename").getString());
+    if (!igm::loadRaw(filename, raw, bvhVariant)) {
+        IG_LOG(L_WARNING) << "Shape '" << name << "': Can not load shape given by file " << filename << std::endl;
+        return false;
+    }
+
+    // The data can be copied directly into the tables only if no further modification is requested
+    const bool unmodified = !elem.property("flip_normals").getBool()
+                            && !elem.property("face_normals").getBool()
+                            && !elem.property("optimize").getBool()
+                            && elem.property("transform").getTransform().matrix().isIdentity();
+
+    if (unmodified && raw.findBVH(bvhVariant))
+        return true;
+
+    // A decoded mesh is required for the modifications or the bvh construction
+    mesh = igm::decodeShapeData(raw.ShapeData);
+    if (mesh.vertices.empty()) {
+        IG_LOG(L_WARNING) << "Shape '" << name << "': Can not decode shape given by file " << filename << std::endl;
+        raw = igm::MeshFile{};
+        return false;
+    }
+
+    if (!unmodified)
+        raw = igm::MeshFile{};
+    else
+        raw.BVHs.clear();
+
+    return true;
+}
+
 template <size_t N, size_t T>
 struct BvhTemporary {
     std::vector<typename BvhNTriM<N, T>::Node, tbb::scalable_allocator<typename BvhNTriM<N, T>::Node>> nodes;
     std::vector<typename BvhNTriM<N, T>::Tri, tbb::scalable_allocator<typename BvhNTriM<N, T>::Tri>> tris;
 };
 
+// Strip the leaves down to the primitive ids, which reduces the leaf size from 208 to 16 bytes per packet of four triangles
 template <size_t N, size_t T>
-static void setup_bvhs(const std::vector<TriMesh>& meshes, LoaderResult& result)
+static void compact_bvh_leaves(std::vector<uint8>& data, size_t start)
+{
+    using Node = typename BvhNTriM<N, T>::Node;
+    using Tri  = typename BvhNTriM<N, T>::Tri;
+
+    uint32 header[4];
+    std::memcpy(header, data.data() + start, sizeof(header));
+    const size_t leafStart = start + sizeof(header) + header[0] * sizeof(Node);
+    for (size_t i = 0; i < header[1]; ++i)
+        std::memmove(data.data() + leafStart + i * sizeof(Tri::prim_id), data.data() + leafStart + i * sizeof(Tri) + offsetof(Tri, prim_id), sizeof(Tri::prim_id));
+    data.resize(leafStart + header[1] * sizeof(Tri::prim_id));
+}
+
+template <size_t N, size_t T>
+static void setup_bvhs(const std::vector<TriMesh>& meshes, const std::vector<igm::MeshFile>& raws, const std::vector<uint32>& bvhFlags, LoaderResult& result)
 {
     // Preload map entries
     std::vector<BvhTemporary<N, T>> bvhs;
@@ -203,17 +252,41 @@ static void setup_bvhs(const std::vector<TriMesh>& meshes, LoaderResult& result)
     // Write non-parallel
     IG_LOG(L_DEBUG) << "Storing BVHs ..." << std::endl;
     const auto start2 = std::chrono::high_resolution_clock::now();
-    for (const auto& bvh : bvhs) {
-        auto& bvhData = result.Database.BVHTable.addLookup(0, 0, DefaultAlignment);
-        VectorSerializer serializer(bvhData, false);
-        serializer.write((uint32)bvh.nodes.size());
-        serializer.write((uint32)bvh.tris.size()); // Not really needed, but just dump it out
-        serializer.write((uint32)0);               // Padding
-        serializer.write((uint32)0);               // Padding
-        serializer.write(bvh.nodes, true);
-        serializer.write(bvh.tris, true);
+    size_t triangleCount = 0;
+    for (size_t id = 0; id < bvhs.size(); ++id) {
+        // Compact leaves are only supported for the cpu layouts
+        const bool compact = T == 4 && (bvhFlags.at(id) & igm::BF_INDEXED_LEAVES);
+
+        auto& bvhData      = result.Database.BVHTable.addLookup(0, compact ? igm::BF_INDEXED_LEAVES : 0, DefaultAlignment);
+        const size_t start = bvhData.size();
+
+        if (const auto* prebuilt = raws.at(id).findBVH(igm::makeBvhVariant(N, T))) {
+            // Prebuilt bvh, just copy it
+            bvhData.insert(bvhData.end(), prebuilt->Data.begin(), prebuilt->Data.end());
+
+            uint32 header[4];
+            std::memcpy(header, raws.at(id).ShapeData.data(), sizeof(header));
+            triangleCount += header[0];
+        } else {
+            const auto& bvh = bvhs[id];
+            VectorSerializer serializer(bvhData, false);
+            serializer.write((uint32)bvh.nodes.size());
+            serializer.write((uint32)bvh.tris.size()); // Not really needed, but just dump it out
+            serializer.write((uint32)0);               // Padding
+            serializer.write((uint32)0);               // Padding
+            serializer.write(bvh.nodes, true);
+            serializer.write(bvh.tris, true);
+
+            triangleCount += meshes.at(id).faceCount();
+        }
+
+        if (compact)
+            compact_bvh_leaves<N, T>(bvhData, start);
     }
     IG_LOG(L_DEBUG) << "Storing BVHs took " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start2).count() / 1000.0f << " seconds" << std::endl;
+
+    const size_t bvhBytes = result.Database.BVHTable.data().size();
+    IG_LOG(L_DEBUG) << "BVHs require " << bvhBytes << " bytes for " << triangleCount << " triangles (" << (bvhBytes / (float)std::max<size_t>(1, triangleCount)) << " bytes per triangle)" << std::endl;
 }
 
 bool LoaderShape::load(LoaderContext& ctx, LoaderResult& result)
@@ -230,6 +303,26 @@ bool LoaderShape::load(LoaderContext& ctx, LoaderResult& result)
     meshes.resize(ctx.Scene.shapes().size());
     std::vector<BoundingBox> boxes;
     boxes.resize(ctx.Scene.shapes().size());
+    // Raw data from native mesh files which can be copied without any processing
+    std::vector<igm::MeshFile> raws;
+    raws.resize(ctx.Scene.shapes().size());
+    // Flags for the shape table
+    std::vector<uint32> flags;
+    flags.resize(ctx.Scene.shapes().size(), 0);
+    // Flags for the bvh table
+    std::vector<uint32> bvhFlags;
+    bvhFlags.resize(ctx.Scene.shapes().size(), 0);
+
+    uint32 bvhVariant;
+    if (ctx.Target == Target::NVVM || ctx.Target == Target::AMDGPU)
+        bvhVariant = igm::makeBvhVariant(2, 1);
+    else if (ctx.Target == Target::GENERIC || ctx.Target == Target::ASIMD || ctx.Target == Target::SSE42)
+        bvhVariant = igm::makeBvhVariant(4, 4);
+    else
+        bvhVariant = igm::makeBvhVariant(8, 4);
+
+    // Mitsuba serialized files are usually referenced multiple times, only scan them once
+    mts::DictionaryCache mtsCache;
 
     // Load meshes in parallel
     // This is not always useful as the bottleneck is provably the IO, but better trying...
@@ -237,8 +330,21 @@ bool LoaderShape::load(LoaderContext& ctx, LoaderResult& result)
         const std::string name = std::string(ids.at(i));
         const auto child       = ctx.Scene.shape(name);
 
+        if (child->property("compact_bvh").getBool())
+            bvhFlags[i] |= igm::BF_INDEXED_LEAVES;
+
         TriMesh& mesh = meshes[i];
-        if (child->pluginType() == "triangle") {
+        if (child->pluginType() == "ig") {
+            if (!setup_mesh_ig(name, *child, ctx, bvhVariant, mesh, raws[i]))
+                return;
+
+            if (!raws[i].ShapeData.empty() && mesh.vertices.empty()) {
+                // Bounding box is given by the file
+                boxes[i] = raws[i].BoundingBox;
+                boxes[i].inflate(1e-5f); // Make sure it has a volume
+                return;
+            }
+        } else if (child->pluginType() == "triangle") {
             mesh = setup_mesh_triangle(*child);
         } else if (child->pluginType() == "rectangle") {
             mesh = setup_mesh_rectangle(*child);
@@ -257,7 +363,7 @@ bool LoaderShape::load(LoaderContext& ctx, LoaderResult& result)
         } else if (child->pluginType() == "ply") {
             mesh = setup_mesh_ply(name, *child, ctx);
         } else if (child->pluginType() == "mitsuba") {
-            mesh = setup_mesh_mitsuba(name, *child, ctx);
+            mesh = setup_mesh_mitsuba(name, *child, ctx, mtsCache);
         } else {
             IG_LOG(L_WARNING) << "Shape '" << name << "': Can not load shape type '" << child->pluginType() << "'" << std::endl;
             return;
@@ -284,6 +390,14 @@ bool LoaderShape::load(LoaderContext& ctx, LoaderResult& result)
                 mesh.face_normals[i] = transform.applyNormal(mesh.face_normals[i]);
         }
 
+        if (child->property("optimize").getBool()) {
+            const size_t prevCount = mesh.vertices.size();
+            const size_t removed   = mesh.weldVertices();
+            mesh.reorderForLocality();
+            flags[i] |= igm::SF_OCT_NORMALS;
+            IG_LOG(L_DEBUG) << "Shape '" << name << "': Optimized mesh from " << prevCount << " to " << mesh.vertices.size() << " vertices (" << removed << " welded)" << std::endl;
+        }
+
         // Build bounding box
         BoundingBox& bbox = boxes[i];
         bbox              = BoundingBox::Empty();
@@ -315,45 +429,54 @@ bool LoaderShape::load(LoaderContext& ctx, LoaderResult& result)
         const size_t id     = counter++;
         const TriMesh& mesh = meshes.at(id);
 
+        const igm::MeshFile& raw = raws.at(id);
+        const bool useRaw        = !raw.ShapeData.empty();
+
         // Register shape into environment
         Shape shape;
-        shape.VertexCount = mesh.vertices.size();
-        shape.NormalCount = mesh.normals.size();
-        shape.TexCount    = mesh.texcoords.size();
-        shape.FaceCount   = mesh.faceCount();
+        if (useRaw) {
+            uint32 header[4];
+            std::memcpy(header, raw.ShapeData.data(), sizeof(header));
+            shape.FaceCount   = header[0];
+            shape.VertexCount = header[1];
+            shape.NormalCount = header[2];
+            shape.TexCount    = header[3];
+        } else {
+            shape.VertexCount = mesh.vertices.size();
+            shape.NormalCount = mesh.normals.size();
+            shape.TexCount    = mesh.texcoords.size();
+            shape.FaceCount   = mesh.faceCount();
+        }
         shape.BoundingBox = boxes.at(id);
 
         const uint32 shapeID = ctx.Environment.Shapes.size();
         ctx.Environment.Shapes.push_back(shape);
         ctx.Environment.ShapeIDs[pair.first] = shapeID;
 
-        IG_ASSERT(mesh.face_normals.size() == mesh.faceCount(), "Expected valid face normals!");
-        IG_ASSERT((mesh.indices.size() % 4) == 0, "Expected index buffer count to be a multiple of 4!");
-
         // Export data:
         IG_LOG(L_DEBUG) << "Generating triangle mesh for shape " << pair.first << std::endl;
 
-        auto& meshData = result.Database.ShapeTable.addLookup(0, 0, DefaultAlignment); // TODO: No use of the typeid currently
+        auto& meshData = result.Database.ShapeTable.addLookup(0, flags.at(id), DefaultAlignment); // TODO: No use of the typeid currently
+        if (useRaw) {
+            // Already in the expected layout
+            meshData.insert(meshData.end(), raw.ShapeData.begin(), raw.ShapeData.end());
+            continue;
+        }
+
+        IG_ASSERT(mesh.face_normals.size() == mesh.faceCount(), "Expected valid face normals!");
+        IG_ASSERT((mesh.indices.size() % 4) == 0, "Expected index buffer count to be a multiple of 4!");
+
         VectorSerializer meshSerializer(meshData, false);
-        meshSerializer.write((uint32)mesh.faceCount());
-        meshSerializer.write((uint32)mesh.vertices.size());
-        meshSerializer.write((uint32)mesh.normals.size());
-        meshSerializer.write((uint32)mesh.texcoords.size());
-        meshSerializer.writeAligned(mesh.vertices, DefaultAlignment, true);
-        meshSerializer.writeAligned(mesh.normals, DefaultAlignment, true);
-        meshSerializer.writeAligned(mesh.face_normals, DefaultAlignment, true);
-        meshSerializer.write(mesh.indices, true);   // Already aligned
-        meshSerializer.write(mesh.texcoords, true); // Aligned to 4*2 bytes
-        meshSerializer.write(mesh.face_inv_area, true);
+        igm::writeShapeData(meshSerializer, mesh, flags.at(id));
     }
     IG_LOG(L_DEBUG) << "Storing of shapes took " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start2).count() / 1000.0f << " seconds" << std::endl;
 
     if (ctx.Target == Target::NVVM || ctx.Target == Target::AMDGPU) {
-        setup_bvhs<2, 1>(meshes, result);
+        setup_bvhs<2, 1>(meshes, raws, bvhFlags, result);
     } else if (ctx.Target == Target::GENERIC || ctx.Target == Target::ASIMD || ctx.Target == Target::SSE42) {
-        setup_bvhs<4, 4>(meshes, result);
+        setup_bvhs<4, 4>(meshes, raws, bvhFlags, result);
     } else {
-        setup_bvhs<8, 4>(meshes, result);
+        setup_bvhs<8, 4>(meshes, raws, bvhFlags, result);
     }
 
     return true;
@@ -1,6 +1,8 @@
 #include "LoaderTechnique.h"
 #include "Loader.h"
+#include "LoaderLight.h"
 #include "Logger.h"
+#include "ShaderUtils.h"
 #include "serialization/VectorSerializer.h"
 
 namespace IG {
@@ -28,10 +30,11 @@ static void debug_body_loader(std::ostream& stream, const std::string&, const st
     stream << "  let technique = make_debug_renderer(settings.debug_mode);" << std::endl;
 }
 
-static TechniqueInfo path_get_info(const std::string&, const std::shared_ptr<Parser::Object>& technique, const LoaderContext&)
+// The aovs are shared between the path tracer and the guided path tracer
+static void path_get_aov_info(TechniqueInfo& info, const std::shared_ptr<Parser::Object>& technique, const LoaderContext& ctx)
 {
-    TechniqueInfo info;
-    if (technique->property("aov_normals").getBool(false))
+    // The denoiser requires normals, albedo and depth
+    if (technique->property("aov_normals").getBool(ctx.Denoise))
         info.EnabledAOVs.push_back("Normals");
 
     if (technique->property("aov_mis").getBool(false)) {
@@ -44,17 +47,21 @@ static TechniqueInfo path_get_info(const std::string&, const std::shared_ptr<Par
         info.EnabledAOVs.push_back("Stats");
     }
 
-    info.UsesLights = { true };
+    if (technique->property("aov_albedo").getBool(ctx.Denoise))
+        info.EnabledAOVs.push_back("Albedo");
 
-    return info;
+    if (technique->property("aov_depth").getBool(ctx.Denoise))
+        info.EnabledAOVs.push_back("Depth");
 }
 
-static void path_body_loader(std::ostream& stream, const std::string&, const std::shared_ptr<Parser::Object>& technique, const LoaderContext&)
+// Defines 'aovs' for the ids used in pathtracer.art
+static void path_aov_loader(std::ostream& stream, const std::shared_ptr<Parser::Object>& technique, const LoaderContext& ctx)
 {
-    const int max_depth     = technique->property("max_depth").getInteger(64);
-    const bool hasNormalAOV = technique->property("aov_normals").getBool(false);
+    const bool hasNormalAOV = technique->property("aov_normals").getBool(ctx.Denoise);
     const bool hasMISAOV    = technique->property("aov_mis").getBool(false);
     const bool hasStatsAOV  = technique->property("aov_stats").getBool(false);
+    const bool hasAlbedoAOV = technique->property("aov_albedo").getBool(ctx.Denoise);
+    const bool hasDepthAOV  = technique->property("aov_depth").getBool(ctx.Denoise);
 
     size_t counter = 1;
     if (hasNormalAOV)
@@ -68,6 +75,12 @@ static void path_body_loader(std::ostream& stream, const std::string&, const std
     if (hasStatsAOV)
         stream << "  let aov_stats = device.load_aov_image(" << counter++ << ", spp);" << std::endl;
 
+    if (hasAlbedoAOV)
+        stream << "  let aov_albedo = device.load_aov_image(" << counter++ << ", spp);" << std::endl;
+
+    if (hasDepthAOV)
+        stream << "  let aov_depth = device.load_aov_image(" << counter++ << ", spp);" << std::endl;
+
     stream << "  let aovs = @|id:i32| -> AOVImage {" << std::endl
            << "    match(id) {" << std::endl;
 
@@ -84,11 +97,37 @@ static void path_body_loader(std::ostream& stream, const std::string&, const std
     if (hasStatsAOV)
         stream << "      4 => aov_stats," << std::endl;
 
+    if (hasAlbedoAOV)
+        stream << "      5 => aov_albedo," << std::endl;
+
+    if (hasDepthAOV)
+        stream << "      6 => aov_depth," << std::endl;
+
     stream << "      _ => make_empty_aov_image()" << std::endl
            << "    }" << std::endl
            << "  };" << std::endl;
+}
+
+static TechniqueInfo path_get_info(const std::string&, const std::shared_ptr<Parser::Object>& technique, const LoaderContext& ctx)
+{
+    TechniqueInfo info;
+    path_get_aov_info(info, technique, ctx);
+
+    info.UsesLights       = { true };
+    info.ShadowRaysPerHit = (uint32)std::max(1, technique->property("light_samples").getInteger(1));
+
+    return info;
+}
+
+static void path_body_loader(std::ostream& stream, const std::string&, const std::shared_ptr<Parser::Object>& technique, const LoaderContext& ctx)
+{
+    const int max_depth   = technique->property("max_depth").getInteger(64);
+    const int rr_start    = technique->property("rr_start_depth").getInteger(1);
+    const float rr_thresh = technique->property("rr_threshold").getNumber(1.0f);
+
+    path_aov_loader(stream, technique, ctx);
 
-    stream << "  let technique = make_path_renderer(" << max_depth << ", num_lights, lights, aovs);" << std::endl;
+    stream << "  let technique = make_path_renderer(" << max_depth << ", " << rr_start << ", " << std::max(1e-4f, rr_thresh) << ", num_lights, lights, aovs);" << std::endl;
 }
 
 static void path_header_loader(std::ostream& stream, const std::string&, const std::shared_ptr<Parser::Object>&, const LoaderContext&)
@@ -98,6 +137,133 @@ static void path_header_loader(std::ostream& stream, const std::string&, const s
            << "fn init_raypayload() = wrap_ptraypayload(PTRayPayload { mis = 0, contrib = white, depth = 1 });" << std::endl;
 }
 
+// Variant 0 and 1 train the guiding field, variant 2 only renders with it
+constexpr uint32 GuidedVariantCount = 3;
+static TechniqueInfo guided_get_info(const std::string& name, const std::shared_ptr<Parser::Object>& technique, const LoaderContext& ctx)
+{
+    TechniqueInfo info = path_get_info(name, technique, ctx);
+
+    info.VariantCount              = GuidedVariantCount;
+    info.UseAdvancedShadowHandling = std::vector<bool>(GuidedVariantCount, info.UseAdvancedShadowHandling.front());
+    info.UsesLights                = std::vector<bool>(GuidedVariantCount, true);
+    info.UsesAllLightsInMiss       = std::vector<bool>(GuidedVariantCount, false);
+    info.RequiresGlobalMaterials   = std::vector<bool>(GuidedVariantCount, false);
+    info.OverrideCameraGenerator   = std::vector<TechniqueCameraGenerator>(GuidedVariantCount, nullptr);
+
+    const uint32 trainingIterations = (uint32)std::max(0, technique->property("training_iterations").getInteger(32));
+    info.VariantSelector            = [=](uint32 iter) { return iter < trainingIterations ? iter % 2 : 2; };
+
+    return info;
+}
+
+static void guided_body_loader(std::ostream& stream, const std::string&, const std::shared_ptr<Parser::Object>& technique, const LoaderContext& ctx)
+{
+    const int max_depth     = technique->property("max_depth").getInteger(64);
+    const int rr_start      = technique->property("rr_start_depth").getInteger(1);
+    const float rr_thresh   = technique->property("rr_threshold").getNumber(1.0f);
+    const float bsdf_frac   = std::min(1.0f, std::max(0.0f, technique->property("bsdf_fraction").getNumber(0.5f)));
+    const int spatial_res   = std::min(64, std::max(1, technique->property("spatial_resolution").getInteger(16)));
+    const int dir_res       = std::min(32, std::max(1, technique->property("directional_resolution").getInteger(8)));
+    const size_t field_size = (size_t)spatial_res * spatial_res * spatial_res * (dir_res * dir_res + 1) * sizeof(float);
+
+    path_aov_loader(stream, technique, ctx);
+
+    const BoundingBox bbox = ctx.Environment.Entities.empty() ? BoundingBox() : ctx.Environment.SceneBBox;
+
+    // Both fields persist across iterations and only grow. Each training variant samples the field of the other
+    // variant and records into its own, such that the sampling density never changes while rendering
+    const bool training = ctx.CurrentTechniqueVariant < 2;
+    stream << "  let guiding_0 = device.request_buffer(\"guiding_0\", " << field_size << ");" << std::endl
+           << "  let guiding_1 = device.request_buffer(\"guiding_1\", " << field_size << ");" << std::endl
+           << "  let guiding = make_guiding_field(" << ShaderUtils::inlineVector(bbox.min) << ", " << ShaderUtils::inlineVector(bbox.max)
+           << ", " << spatial_res << ", " << dir_res << ", ";
+    if (training) {
+        const uint32 own = ctx.CurrentTechniqueVariant;
+        stream << "guiding_" << 1 - own << ".load_f32, guiding_" << own << ".add_f32);" << std::endl;
+    } else {
+        stream << "@|i| guiding_0.load_f32(i) + guiding_1.load_f32(i), @|_, _| {});" << std::endl;
+    }
+
+    stream << "  let technique = make_guided_renderer(" << max_depth << ", " << rr_start << ", " << std::max(1e-4f, rr_thresh) << ", " << bsdf_frac
+           << ", " << (training ? "true" : "false") << ", guiding, num_lights, lights, aovs);" << std::endl;
+}
+
+static void guided_header_loader(std::ostream& stream, const std::string&, const std::shared_ptr<Parser::Object>&, const LoaderContext&)
+{
+    constexpr int C = 1 /* MIS */ + 3 /* Contrib */ + 1 /* Depth */ + 2 /* Guiding Cell & Bin */;
+    stream << "static RayPayloadComponents = " << C << ";" << std::endl
+           << "fn init_raypayload() = wrap_guidedraypayload(GuidedRayPayload { mis = 0, contrib = white, depth = 1, cell = -1, bin = 0 });" << std::endl;
+}
+
+// Variant 0 renders the light sources seen directly by the camera, variant 1 traces paths from the light sources
+constexpr uint32 LightTracerVariantCount = 2;
+static std::string lighttracer_camera_generator(const LoaderContext& ctx)
+{
+    // The projection in make_light_renderer is only valid for a perspective camera
+    if (ctx.CameraType != "perspective") {
+        IG_LOG(L_ERROR) << "Light tracing only supports the perspective camera" << std::endl;
+        return {};
+    }
+
+    std::stringstream stream;
+    stream << LoaderTechnique::generateHeader(ctx, true) << std::endl;
+
+    stream << "#[export] fn ig_ray_generation_shader(settings: &Settings, iter: i32, id: &mut i32, size: i32, xmin: i32, ymin: i32, xmax: i32, ymax: i32) -> i32 {" << std::endl
+           << "  maybe_unused(settings);" << std::endl
+           << "  " << ShaderUtils::constructDevice(ctx.Target) << std::endl
+           << std::endl;
+
+    stream << ShaderUtils::generateDatabase() << std::endl;
+    stream << LoaderLight::generate(ctx, false) << std::endl;
+
+    stream << "  let spp = " << ctx.SamplesPerIteration << " : i32;" << std::endl
+           << "  let emitter = make_light_emitter(num_lights, lights, iter);" << std::endl
+           << "  device.generate_rays(emitter, id, size, xmin, ymin, xmax, ymax, spp)" << std::endl
+           << "}" << std::endl;
+
+    return stream.str();
+}
+
+static TechniqueInfo lighttracer_get_info(const std::string&, const std::shared_ptr<Parser::Object>&, const LoaderContext&)
+{
+    TechniqueInfo info;
+    info.VariantCount              = LightTracerVariantCount;
+    info.UseAdvancedShadowHandling = { false, true }; // Connections to the camera are splatted in the shadow miss shader
+    info.UsesLights                = { true, false };
+    info.UsesAllLightsInMiss       = { false, false };
+    info.RequiresGlobalMaterials   = { false, false };
+    info.OverrideCameraGenerator   = { nullptr, lighttracer_camera_generator };
+    info.VariantSelector           = [](uint32 iter) { return iter % LightTracerVariantCount; };
+
+    return info;
+}
+
+static void lighttracer_body_loader(std::ostream& stream, const std::string&, const std::shared_ptr<Parser::Object>& technique, const LoaderContext& ctx)
+{
+    if (ctx.CurrentTechniqueVariant == 0) {
+        // Compensate that the camera pass is only used every other iteration
+        stream << "  let technique = make_light_visibility_renderer(" << LightTracerVariantCount << ", num_lights, lights);" << std::endl;
+        return;
+    }
+
+    const int max_depth   = technique->property("max_depth").getInteger(64);
+    const int rr_start    = technique->property("rr_start_depth").getInteger(1);
+    const float rr_thresh = technique->property("rr_threshold").getNumber(1.0f);
+
+    // The light paths are also only traced every other iteration
+    stream << "  let (film, film_width, film_height) = device.load_film_splatter(spp);" << std::endl
+           << "  let lt_film = AOVImage { splat = @|pixel, color| film.splat(pixel, color_mulf(color, " << LightTracerVariantCount << ")), get = film.get };" << std::endl
+           << "  let technique = make_light_renderer(" << max_depth << ", " << rr_start << ", " << std::max(1e-4f, rr_thresh)
+           << ", settings.eye, make_mat3x3(settings.right, settings.up, settings.dir), settings.width, settings.height, lt_film, film_width, film_height);" << std::endl;
+}
+
+static void lighttracer_header_loader(std::ostream& stream, const std::string&, const std::shared_ptr<Parser::Object>&, const LoaderContext&)
+{
+    constexpr int C = 3 /* Contrib */ + 1 /* Depth */;
+    stream << "static RayPayloadComponents = " << C << ";" << std::endl
+           << "fn init_raypayload() = wrap_ltraypayload(LTRayPayload { contrib = white, depth = 1 });" << std::endl;
+}
+
 // Will return information about the enabled AOVs
 using TechniqueGetInfo = TechniqueInfo (*)(const std::string&, const std::shared_ptr<Parser::Object>&, const LoaderContext&);
 
@@ -115,6 +281,8 @@ static struct TechniqueEntry {
 } _generators[] = {
     { "ao", technique_empty_get_info, ao_body_loader, technique_empty_header_loader },
     { "path", path_get_info, path_body_loader, path_header_loader },
+    { "guided", guided_get_info, guided_body_loader, guided_header_loader },
+    { "lighttracer", lighttracer_get_info, lighttracer_body_loader, lighttracer_header_loader },
     { "debug", technique_empty_get_info, debug_body_loader, technique_empty_header_loader },
     { "", nullptr, nullptr, nullptr }
 };
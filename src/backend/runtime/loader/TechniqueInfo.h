@@ -13,6 +13,9 @@ struct TechniqueInfo {
     /// The technique makes uses of ShadowHit and ShadowMiss shaders. Reduces performances. This option is per variant
     std::vector<bool> UseAdvancedShadowHandling = { false };
 
+    /// The number of shadow rays the technique generates per hit. This option is shared across all variants
+    uint32 ShadowRaysPerHit = 1;
+
     /// The technique makes use of lights. This option is per variant
     std::vector<bool> UsesLights = { false };
 
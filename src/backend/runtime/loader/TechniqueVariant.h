@@ -2,9 +2,11 @@
 
 #include "IG_Config.h"
 
+#include <functional>
+
 namespace IG {
 
-using TechniqueVariantSelector = uint32 (*)(uint32);
+using TechniqueVariantSelector = std::function<uint32(uint32)>;
 
 template <typename T>
 struct TechniqueVariantBase {
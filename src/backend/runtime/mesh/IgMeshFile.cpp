@@ -0,0 +1,282 @@
+#include "IgMeshFile.h"
+#include "Logger.h"
+#include "bvh/TriBVHAdapter.h"
+#include "serialization/FileSerializer.h"
+#include "serialization/VectorSerializer.h"
+
+#include <fstream>
+
+namespace IG {
+namespace igm {
+constexpr uint32 FILE_MAGIC   = 0x004D4749; // "IGM\0"
+constexpr uint32 FILE_VERSION = 1;
+constexpr size_t ALIGNMENT    = 16;
+
+/* File layout (little endian, every section starts at a 16 byte boundary):
+ *  Header:  [magic, version, bvh count, reserved] as uint32
+ *  BBox:    [min.x, min.y, min.z, max.x, max.y, max.z] as float, 8 bytes padding
+ *  Shape:   [size, reserved] as uint64, followed by the shape block as written into the shape table
+ *  BVH[i]:  [variant, reserved] as uint32, [size] as uint64, followed by the bvh block as written into the bvh table
+ */
+
+inline static size_t alignedSize(size_t size) { return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1); }
+
+inline static uint32 encodeOctNormal(const Vector3f& n)
+{
+    const float l1 = std::abs(n(0)) + std::abs(n(1)) + std::abs(n(2));
+    Vector2f p     = l1 > FltEps ? Vector2f(n(0) / l1, n(1) / l1) : Vector2f(0, 0);
+    if (n(2) < 0) {
+        p = Vector2f((1 - std::abs(p(1))) * (p(0) >= 0 ? 1.0f : -1.0f),
+                     (1 - std::abs(p(0))) * (p(1) >= 0 ? 1.0f : -1.0f));
+    }
+
+    const auto quantize = [](float f) { return (uint16)(int16)std::round(std::min(std::max(f, -1.0f), 1.0f) * 32767.0f); };
+    return (uint32)quantize(p(0)) | ((uint32)quantize(p(1)) << 16);
+}
+
+void writeShapeData(Serializer& serializer, const TriMesh& mesh, uint32 flags)
+{
+    serializer.write((uint32)mesh.faceCount());
+    serializer.write((uint32)mesh.vertices.size());
+    serializer.write((uint32)mesh.normals.size());
+    serializer.write((uint32)mesh.texcoords.size());
+    serializer.writeAligned(mesh.vertices, ALIGNMENT, true);
+    if (flags & SF_OCT_NORMALS) {
+        for (const auto& n : mesh.normals)
+            serializer.write(encodeOctNormal(n));
+        for (size_t i = mesh.normals.size(); i < alignedSize(mesh.normals.size() * sizeof(uint32)) / sizeof(uint32); ++i)
+            serializer.write((uint32)0); // Padding
+    } else {
+        serializer.writeAligned(mesh.normals, ALIGNMENT, true);
+    }
+    serializer.writeAligned(mesh.face_normals, ALIGNMENT, true);
+    serializer.write(mesh.indices, true);   // Already aligned
+    serializer.write(mesh.texcoords, true); // Aligned to 4*2 bytes
+    serializer.write(mesh.face_inv_area, true);
+}
+
+template <typename T>
+inline static void decodeArray(const uint8* ptr, size_t count, size_t stride, std::vector<T>& out)
+{
+    out.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        std::memcpy(&out[i], ptr + i * stride, sizeof(T));
+}
+
+TriMesh decodeShapeData(const std::vector<uint8>& data)
+{
+    if (data.size() < 4 * sizeof(uint32))
+        return TriMesh{};
+
+    uint32 header[4];
+    std::memcpy(header, data.data(), sizeof(header));
+    const size_t faceCount   = header[0];
+    const size_t vertexCount = header[1];
+    const size_t normalCount = header[2];
+    const size_t texCount    = header[3];
+
+    const size_t expectedSize = sizeof(header)
+                                + ALIGNMENT * (vertexCount + normalCount + faceCount)
+                                + sizeof(uint32) * 4 * faceCount
+                                + sizeof(float) * 2 * texCount
+                                + sizeof(float) * faceCount;
+    if (data.size() < expectedSize)
+        return TriMesh{};
+
+    TriMesh mesh;
+    const uint8* ptr = data.data() + sizeof(header);
+    decodeArray(ptr, vertexCount, ALIGNMENT, mesh.vertices);
+    ptr += ALIGNMENT * vertexCount;
+    decodeArray(ptr, normalCount, ALIGNMENT, mesh.normals);
+    ptr += ALIGNMENT * normalCount;
+    decodeArray(ptr, faceCount, ALIGNMENT, mesh.face_normals);
+    ptr += ALIGNMENT * faceCount;
+    decodeArray(ptr, faceCount * 4, sizeof(uint32), mesh.indices);
+    ptr += sizeof(uint32) * 4 * faceCount;
+    decodeArray(ptr, texCount, sizeof(float) * 2, mesh.texcoords);
+    ptr += sizeof(float) * 2 * texCount;
+    decodeArray(ptr, faceCount, sizeof(float), mesh.face_inv_area);
+
+    return mesh;
+}
+
+template <size_t N, size_t T>
+inline static void writeBvhDataT(Serializer& serializer, const TriMesh& mesh)
+{
+    std::vector<typename BvhNTriM<N, T>::Node> nodes;
+    std::vector<typename BvhNTriM<N, T>::Tri> tris;
+    if (mesh.faceCount() > 0)
+        build_bvh<N, T, std::allocator>(mesh, nodes, tris);
+
+    serializer.write((uint32)nodes.size());
+    serializer.write((uint32)tris.size());
+    serializer.write((uint32)0); // Padding
+    serializer.write((uint32)0); // Padding
+    serializer.write(nodes, true);
+    serializer.write(tris, true);
+}
+
+bool writeBvhData(Serializer& serializer, const TriMesh& mesh, uint32 variant)
+{
+    switch (variant) {
+    case makeBvhVariant(2, 1):
+        writeBvhDataT<2, 1>(serializer, mesh);
+        return true;
+    case makeBvhVariant(4, 4):
+        writeBvhDataT<4, 4>(serializer, mesh);
+        return true;
+    case makeBvhVariant(8, 4):
+        writeBvhDataT<8, 4>(serializer, mesh);
+        return true;
+    default:
+        return false;
+    }
+}
+
+template <typename T>
+inline static void readValue(std::istream& stream, T& value)
+{
+    stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+inline static bool readBlock(std::istream& stream, std::vector<uint8>& data, uint64 size)
+{
+    // Read everything in one go, no further processing is necessary
+    data.resize(size);
+    stream.read(reinterpret_cast<char*>(data.data()), size);
+    stream.seekg(alignedSize(size) - size, std::ios::cur);
+    return stream.good();
+}
+
+bool loadRaw(const std::filesystem::path& path, MeshFile& file, uint32 bvhVariant)
+{
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (!stream) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' can not be opened." << std::endl;
+        return false;
+    }
+
+    uint32 header[4];
+    stream.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!stream.good() || header[0] != FILE_MAGIC) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' is not a valid Ignis mesh file." << std::endl;
+        return false;
+    }
+
+    if (header[1] != FILE_VERSION) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' has an unsupported version number " << header[1] << " != " << FILE_VERSION << "." << std::endl;
+        return false;
+    }
+
+    const uint32 bvhCount = header[2];
+
+    float bbox[8];
+    stream.read(reinterpret_cast<char*>(bbox), sizeof(bbox));
+    file.BoundingBox = BoundingBox(Vector3f(bbox[0], bbox[1], bbox[2]), Vector3f(bbox[3], bbox[4], bbox[5]));
+
+    uint64 shapeHeader[2];
+    stream.read(reinterpret_cast<char*>(shapeHeader), sizeof(shapeHeader));
+    if (!stream.good() || !readBlock(stream, file.ShapeData, shapeHeader[0])) {
+        IG_LOG(L_ERROR) << "IgMeshFile " << path << ": Could not read shape data." << std::endl;
+        return false;
+    }
+
+    file.BVHs.clear();
+    for (uint32 i = 0; i < bvhCount; ++i) {
+        uint32 variant;
+        uint32 reserved;
+        uint64 size;
+        readValue(stream, variant);
+        readValue(stream, reserved);
+        readValue(stream, size);
+
+        if (!stream.good()) {
+            IG_LOG(L_ERROR) << "IgMeshFile " << path << ": Could not read bvh header." << std::endl;
+            return false;
+        }
+
+        if (bvhVariant != 0 && bvhVariant != variant) {
+            stream.seekg(alignedSize(size), std::ios::cur);
+            continue;
+        }
+
+        BVHBlock block;
+        block.Variant = variant;
+        if (!readBlock(stream, block.Data, size)) {
+            IG_LOG(L_ERROR) << "IgMeshFile " << path << ": Could not read bvh data." << std::endl;
+            return false;
+        }
+        file.BVHs.push_back(std::move(block));
+    }
+
+    return true;
+}
+
+TriMesh load(const std::filesystem::path& path)
+{
+    MeshFile file;
+    if (!loadRaw(path, file, 0xFFFFFFFF /* Skip all bvhs */))
+        return TriMesh{};
+
+    TriMesh mesh = decodeShapeData(file.ShapeData);
+    if (mesh.vertices.empty())
+        IG_LOG(L_ERROR) << "IgMeshFile " << path << ": Invalid shape data." << std::endl;
+    return mesh;
+}
+
+inline static void writeBlock(Serializer& serializer, const std::vector<uint8>& data)
+{
+    serializer.write(data, true);
+    for (size_t i = data.size(); i < alignedSize(data.size()); ++i)
+        serializer.write((uint8)0);
+}
+
+bool save(const std::filesystem::path& path, const TriMesh& mesh, const std::vector<uint32>& bvhVariants)
+{
+    FileSerializer serializer(path, false);
+    if (!serializer.isValid()) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' can not be opened for writing." << std::endl;
+        return false;
+    }
+
+    BoundingBox bbox = BoundingBox::Empty();
+    for (const auto& v : mesh.vertices)
+        bbox.extend(v);
+
+    serializer.write(FILE_MAGIC);
+    serializer.write(FILE_VERSION);
+    serializer.write((uint32)bvhVariants.size());
+    serializer.write((uint32)0);
+
+    for (int i = 0; i < 3; ++i)
+        serializer.write(bbox.min(i));
+    for (int i = 0; i < 3; ++i)
+        serializer.write(bbox.max(i));
+    serializer.write((uint32)0);
+    serializer.write((uint32)0);
+
+    std::vector<uint8> shapeData;
+    VectorSerializer shapeSerializer(shapeData, false);
+    writeShapeData(shapeSerializer, mesh);
+    serializer.write((uint64)shapeData.size());
+    serializer.write((uint64)0);
+    writeBlock(serializer, shapeData);
+
+    for (uint32 variant : bvhVariants) {
+        std::vector<uint8> bvhData;
+        VectorSerializer bvhSerializer(bvhData, false);
+        if (!writeBvhData(bvhSerializer, mesh, variant)) {
+            IG_LOG(L_ERROR) << "IgMeshFile " << path << ": Unknown bvh variant " << std::hex << variant << std::dec << "." << std::endl;
+            return false;
+        }
+
+        serializer.write(variant);
+        serializer.write((uint32)0);
+        serializer.write((uint64)bvhData.size());
+        writeBlock(serializer, bvhData);
+    }
+
+    return true;
+}
+} // namespace igm
+} // namespace IG
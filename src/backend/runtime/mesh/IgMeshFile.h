@@ -0,0 +1,57 @@
+#pragma once
+
+#include "TriMesh.h"
+#include "math/BoundingBox.h"
+
+namespace IG {
+class Serializer;
+
+namespace igm {
+// Native binary mesh format.
+// The shape block is stored in the exact layout used by the shape table, which allows it to be copied
+// into the scene database without any further processing. Optionally, prebuilt bvhs are stored alongside.
+struct BVHBlock {
+    uint32 Variant; // See makeBvhVariant
+    std::vector<uint8> Data;
+};
+
+struct MeshFile {
+    IG::BoundingBox BoundingBox = IG::BoundingBox::Empty();
+    std::vector<uint8> ShapeData;
+    std::vector<BVHBlock> BVHs;
+
+    inline const BVHBlock* findBVH(uint32 variant) const
+    {
+        for (const auto& bvh : BVHs) {
+            if (bvh.Variant == variant)
+                return &bvh;
+        }
+        return nullptr;
+    }
+};
+
+inline constexpr uint32 makeBvhVariant(size_t N, size_t T) { return static_cast<uint32>((N << 16) | T); }
+
+// Flags stored in the lookup entry of the shape table. Has to be in sync with shape.art
+enum ShapeFlags : uint32 {
+    SF_OCT_NORMALS = 0x1 // Vertex normals are stored in a 2x16bit octahedral encoding
+};
+
+// Flags stored in the lookup entry of the bvh table. Has to be in sync with intersection.art
+enum BvhFlags : uint32 {
+    BF_INDEXED_LEAVES = 0x1 // Leaves only contain the primitive ids, the triangles are fetched from the shape table
+};
+
+// Write mesh in the layout expected by the shape table
+void writeShapeData(Serializer& serializer, const TriMesh& mesh, uint32 flags = 0);
+// Decode shape table layout back to a mesh. Only data written without flags is supported
+TriMesh decodeShapeData(const std::vector<uint8>& data);
+// Build bvh for the given variant and write it in the layout expected by the bvh table
+bool writeBvhData(Serializer& serializer, const TriMesh& mesh, uint32 variant);
+
+// Load file without decoding the shape block. If bvhVariant is not zero, only a bvh matching the variant will be loaded
+bool loadRaw(const std::filesystem::path& path, MeshFile& file, uint32 bvhVariant = 0);
+TriMesh load(const std::filesystem::path& path);
+bool save(const std::filesystem::path& path, const TriMesh& mesh, const std::vector<uint32>& bvhVariants = {});
+} // namespace igm
+} // namespace IG
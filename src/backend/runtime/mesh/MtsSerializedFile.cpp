@@ -2,25 +2,23 @@
 #include "Logger.h"
 
 #include <fstream>
-#include <sstream>
+#include <mutex>
+#include <unordered_map>
 
 #include <zlib.h>
 
 namespace IG {
 namespace mts {
-constexpr size_t BUFFER_SIZE = 32768;
+// Inflates a shape block which is completely available in memory
 class CompressedStream {
 public:
-    inline CompressedStream(std::istream& in, size_t size)
-        : mIn(in)
-        , mSize(size)
-        , mPos(0)
+    inline CompressedStream(const uint8* data, size_t size)
     {
         mStream.zalloc   = Z_NULL;
         mStream.zfree    = Z_NULL;
         mStream.opaque   = Z_NULL;
-        mStream.avail_in = 0;
-        mStream.next_in  = Z_NULL;
+        mStream.avail_in = (uInt)size;
+        mStream.next_in  = const_cast<uint8*>(data);
 
         int retval = inflateInit2(&mStream, 15);
         if (retval != Z_OK)
@@ -32,62 +30,156 @@ public:
         inflateEnd(&mStream);
     }
 
-    template <typename T>
-    inline void read(T* ptr)
+    inline bool read(void* ptr, size_t size)
     {
-        size_t size        = sizeof(T);
-        uint8_t* targetPtr = (uint8_t*)ptr;
+        uint8* targetPtr = reinterpret_cast<uint8*>(ptr);
         while (size > 0) {
-            if (mStream.avail_in == 0) {
-                size_t remaining = mSize - mPos;
-                mStream.next_in  = mBuffer;
-                mStream.avail_in = (uInt)std::min(remaining, sizeof(mBuffer));
-                if (mStream.avail_in == 0)
-                    IG_LOG(L_ERROR) << "Read less data than expected (" << size << " more bytes required)" << std::endl;
-                mIn.read(reinterpret_cast<char*>(mBuffer), mStream.avail_in);
-
-                if (!mIn.good())
-                    IG_LOG(L_ERROR) << "Could not read " << mStream.avail_in << " bytes" << std::endl;
-
-                mPos += mStream.avail_in;
-            }
-
-            mStream.avail_out = (uInt)size;
-            mStream.next_out  = targetPtr;
+            // avail_out is limited to 32bit
+            const size_t chunk = std::min<size_t>(size, std::numeric_limits<uInt>::max());
+            mStream.avail_out  = (uInt)chunk;
+            mStream.next_out   = targetPtr;
 
             int retval = inflate(&mStream, Z_NO_FLUSH);
             switch (retval) {
             case Z_STREAM_ERROR:
                 IG_LOG(L_ERROR) << "inflate(): stream error!" << std::endl;
-                break;
+                return false;
             case Z_NEED_DICT:
                 IG_LOG(L_ERROR) << "inflate(): need dictionary!" << std::endl;
-                break;
+                return false;
             case Z_DATA_ERROR:
                 IG_LOG(L_ERROR) << "inflate(): data error!" << std::endl;
-                break;
+                return false;
             case Z_MEM_ERROR:
                 IG_LOG(L_ERROR) << "inflate(): memory error!" << std::endl;
-                break;
+                return false;
             };
 
-            size_t outputSize = size - (size_t)mStream.avail_out;
+            size_t outputSize = chunk - (size_t)mStream.avail_out;
             targetPtr += outputSize;
             size -= outputSize;
 
-            if (size > 0 && retval == Z_STREAM_END)
+            if (size > 0 && (retval == Z_STREAM_END || (retval == Z_BUF_ERROR && mStream.avail_in == 0))) {
                 IG_LOG(L_ERROR) << "inflate(): attempting to read past the end of the stream!" << std::endl;
+                return false;
+            }
         }
+        return true;
+    }
+
+    template <typename T>
+    inline bool read(T* ptr)
+    {
+        return read(ptr, sizeof(T));
+    }
+
+    template <typename T>
+    inline bool readArray(std::vector<T>& buffer, size_t count)
+    {
+        buffer.resize(count);
+        return read(buffer.data(), sizeof(T) * count);
     }
 
 private:
-    std::istream& mIn;
-    size_t mSize;
-    size_t mPos;
     z_stream mStream;
-    uint8_t mBuffer[BUFFER_SIZE];
 };
 
+struct ShapeDictionary {
+    uint16 Version;
+    std::vector<uint64> Offsets;
+    uint64 End; // Start of the dictionary, which marks the end of the last shape
+};
+
+static bool loadDictionary(const std::filesystem::path& path, ShapeDictionary& dict)
+{
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (!stream) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' can not be opened." << std::endl;
+        return false;
+    }
+
+    // Check header
+    uint16_t fileIdent;
+    uint16_t fileVersion;
+    stream.read(reinterpret_cast<char*>(&fileIdent), sizeof(fileIdent));
+
+    if (fileIdent != 0x041C) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' is not a valid Mitsuba serialized file." << std::endl;
+        return false;
+    }
+    stream.read(reinterpret_cast<char*>(&fileVersion), sizeof(fileVersion));
+    if (fileVersion < 3) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' has an insufficient version number " << fileVersion << " < 3." << std::endl;
+        return false;
+    }
+
+    // Extract amount of shapes inside the file
+    uint32_t shapeCount;
+    stream.seekg(-std::streamoff(sizeof(shapeCount)), std::ios::end);
+    stream.read(reinterpret_cast<char*>(&shapeCount), sizeof(shapeCount));
+
+    if (!stream.good()) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' can not access end of file dictionary." << std::endl;
+        return false;
+    }
+
+    // Read the whole dictionary at once. Version 3 uses uint32_t instead of uint64_t
+    const size_t entrySize = fileVersion >= 4 ? sizeof(uint64_t) : sizeof(uint32_t);
+    stream.seekg(-std::streamoff(sizeof(shapeCount) + entrySize * shapeCount), std::ios::end);
+    const uint64 dictStart = stream.tellg();
+
+    dict.Version = fileVersion;
+    dict.Offsets.resize(shapeCount);
+    if (fileVersion >= 4) {
+        stream.read(reinterpret_cast<char*>(dict.Offsets.data()), entrySize * shapeCount);
+    } else {
+        std::vector<uint32_t> offsets(shapeCount);
+        stream.read(reinterpret_cast<char*>(offsets.data()), entrySize * shapeCount);
+        for (size_t i = 0; i < shapeCount; ++i)
+            dict.Offsets[i] = offsets[i];
+    }
+
+    if (!stream.good()) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' could not extract shape file offsets." << std::endl;
+        return false;
+    }
+
+    dict.End = dictStart;
+    return true;
+}
+
+struct DictionaryCacheInternal {
+    std::mutex Mutex;
+    std::unordered_map<std::string, std::shared_ptr<const ShapeDictionary>> Entries;
+};
+
+DictionaryCache::DictionaryCache()
+    : mInternal(std::make_unique<DictionaryCacheInternal>())
+{
+}
+
+DictionaryCache::~DictionaryCache()
+{
+}
+
+std::shared_ptr<const ShapeDictionary> DictionaryCache::get(const std::filesystem::path& path)
+{
+    const std::string key = std::filesystem::absolute(path).generic_string();
+
+    // The dictionary is small, so loading it while holding the lock is fine
+    std::lock_guard<std::mutex> guard(mInternal->Mutex);
+    auto it = mInternal->Entries.find(key);
+    if (it != mInternal->Entries.end())
+        return it->second;
+
+    auto dict = std::make_shared<ShapeDictionary>();
+    if (!loadDictionary(path, *dict))
+        dict.reset();
+
+    mInternal->Entries[key] = dict; // Failures are cached as well
+    return dict;
+}
+
 enum MeshFlags {
     MF_VERTEXNORMALS = 0x0001,
     MF_TEXCOORDS     = 0x0002,
@@ -98,177 +190,121 @@ enum MeshFlags {
 };
 
 template <typename T>
-void extractMeshVertices(TriMesh& trimesh, CompressedStream& cin, uint32_t flags)
+static bool extractMeshVertices(TriMesh& trimesh, CompressedStream& cin, uint32_t flags)
 {
+    std::vector<T> buffer;
+
     // Vertex Positions
-    for (size_t i = 0; i < trimesh.vertices.size(); ++i) {
-        T x, y, z;
-        cin.read(&x);
-        cin.read(&y);
-        cin.read(&z);
-        trimesh.vertices[i] = Vector3f(x, y, z);
-    }
+    if (!cin.readArray(buffer, trimesh.vertices.size() * 3))
+        return false;
+    for (size_t i = 0; i < trimesh.vertices.size(); ++i)
+        trimesh.vertices[i] = Vector3f(buffer[3 * i + 0], buffer[3 * i + 1], buffer[3 * i + 2]);
 
     // Normals
     if (flags & MF_VERTEXNORMALS) {
-        for (size_t i = 0; i < trimesh.normals.size(); ++i) {
-            T x, y, z;
-            cin.read(&x);
-            cin.read(&y);
-            cin.read(&z);
-            trimesh.normals[i] = Vector3f(x, y, z);
-        }
+        if (!cin.readArray(buffer, trimesh.normals.size() * 3))
+            return false;
+        for (size_t i = 0; i < trimesh.normals.size(); ++i)
+            trimesh.normals[i] = Vector3f(buffer[3 * i + 0], buffer[3 * i + 1], buffer[3 * i + 2]);
     }
 
     // UV
     if (flags & MF_TEXCOORDS) {
-        for (size_t i = 0; i < trimesh.texcoords.size(); ++i) {
-            T x, y;
-            cin.read(&x);
-            cin.read(&y);
-            trimesh.texcoords[i] = Vector2f(x, y);
-        }
+        if (!cin.readArray(buffer, trimesh.texcoords.size() * 2))
+            return false;
+        for (size_t i = 0; i < trimesh.texcoords.size(); ++i)
+            trimesh.texcoords[i] = Vector2f(buffer[2 * i + 0], buffer[2 * i + 1]);
     }
 
     // Vertex Color (ignored)
     if (flags & MF_VERTEXCOLORS) {
-        for (size_t i = 0; i < trimesh.vertices.size() * 3; ++i) {
-            T _ignore;
-            cin.read(&_ignore);
-        }
+        if (!cin.readArray(buffer, trimesh.vertices.size() * 3))
+            return false;
     }
+
+    return true;
 }
 
 template <typename T>
-void extractMeshIndices(TriMesh& trimesh, CompressedStream& cin)
+static bool extractMeshIndices(TriMesh& trimesh, CompressedStream& cin)
 {
     size_t tricount = trimesh.indices.size() / 4;
+
     // Indices
+    std::vector<T> buffer;
+    if (!cin.readArray(buffer, tricount * 3))
+        return false;
+
     for (size_t i = 0; i < tricount; ++i) {
-        T x, y, z;
-        cin.read(&x);
-        cin.read(&y);
-        cin.read(&z);
-        trimesh.indices[i * 4 + 0] = x;
-        trimesh.indices[i * 4 + 1] = y;
-        trimesh.indices[i * 4 + 2] = z;
+        trimesh.indices[i * 4 + 0] = (uint32)buffer[i * 3 + 0];
+        trimesh.indices[i * 4 + 1] = (uint32)buffer[i * 3 + 1];
+        trimesh.indices[i * 4 + 2] = (uint32)buffer[i * 3 + 2];
         trimesh.indices[i * 4 + 3] = 0;
     }
+    return true;
 }
 
-TriMesh load(const std::filesystem::path& path, size_t shapeIndex)
+TriMesh load(const std::filesystem::path& path, size_t shapeIndex, DictionaryCache* cache)
 {
-    std::fstream stream(path, std::ios::in | std::ios::binary);
-    if (!stream) {
-        IG_LOG(L_ERROR) << "Given file '" << path << "' can not be opened." << std::endl;
-        return TriMesh{};
-    }
-
-    // Check header
-    uint16_t fileIdent;
-    uint16_t fileVersion;
-    stream.read(reinterpret_cast<char*>(&fileIdent), sizeof(fileIdent));
-
-    if (fileIdent != 0x041C) {
-        IG_LOG(L_ERROR) << "Given file '" << path << "' is not a valid Mitsuba serialized file." << std::endl;
-        return TriMesh{};
-    }
-    stream.read(reinterpret_cast<char*>(&fileVersion), sizeof(fileVersion));
-    if (fileVersion < 3) {
-        IG_LOG(L_ERROR) << "Given file '" << path << "' has an insufficient version number " << fileVersion << " < 3." << std::endl;
-        return TriMesh{};
+    std::shared_ptr<const ShapeDictionary> dict;
+    if (cache) {
+        dict = cache->get(path);
+    } else {
+        auto tmp = std::make_shared<ShapeDictionary>();
+        if (loadDictionary(path, *tmp))
+            dict = tmp;
     }
 
-    // Extract amount of shapes inside the file
-    uint32_t shapeCount;
-    stream.seekg(-std::streamoff(sizeof(shapeCount)), std::ios::end);
-    stream.read(reinterpret_cast<char*>(&shapeCount), sizeof(shapeCount));
-
-    if (!stream.good()) {
-        IG_LOG(L_ERROR) << "Given file '" << path << "' can not access end of file dictionary." << std::endl;
+    if (!dict)
         return TriMesh{};
-    }
 
+    const size_t shapeCount = dict->Offsets.size();
     if (shapeIndex >= shapeCount) {
         IG_LOG(L_ERROR) << "Given file '" << path << "' can not access shape index " << shapeIndex << " as it only contains " << shapeCount << " shapes." << std::endl;
         return TriMesh{};
     }
 
-    // Extract mesh file start position
-    uint64_t shapeFileStart;
-    uint64_t shapeFileEnd;
-
-    if (fileVersion >= 4) {
-        stream.seekg(-std::streamoff(sizeof(shapeCount) + sizeof(shapeFileStart) * (shapeCount - shapeIndex)), std::ios::end);
-        stream.read(reinterpret_cast<char*>(&shapeFileStart), sizeof(shapeFileStart));
-
-        if (!stream.good()) {
-            IG_LOG(L_ERROR) << "Given file '" << path << "' could not extract shape file offset." << std::endl;
-            return TriMesh{};
-        }
-
-        // Extract mesh file end position
-        if (shapeIndex == shapeCount - 1) {
-            stream.seekg(-std::streamoff(sizeof(shapeCount)), std::ios::end);
-            shapeFileEnd = stream.tellg();
-        } else {
-            stream.seekg(-std::streamoff(sizeof(shapeCount) + sizeof(shapeFileEnd) * (shapeCount - shapeIndex + 1)), std::ios::end);
-            stream.read(reinterpret_cast<char*>(&shapeFileEnd), sizeof(shapeFileEnd));
-        }
-    } else { /* Version 3 uses uint32_t instead of uint64_t */
-        uint32_t _shapeFileStart;
-        uint32_t _shapeFileEnd;
+    const uint64 shapeFileStart = dict->Offsets[shapeIndex];
+    const uint64 shapeFileEnd   = shapeIndex == shapeCount - 1 ? dict->End : dict->Offsets[shapeIndex + 1];
+    if (shapeFileEnd < shapeFileStart + sizeof(uint16_t) * 2) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' has an invalid shape file offset." << std::endl;
+        return TriMesh{};
+    }
 
-        stream.seekg(-std::streamoff(sizeof(shapeCount) + sizeof(_shapeFileStart) * (shapeCount - shapeIndex)), std::ios::end);
-        stream.read(reinterpret_cast<char*>(&_shapeFileStart), sizeof(_shapeFileStart));
+    const size_t contentSize = shapeFileEnd - shapeFileStart - sizeof(uint16_t) * 2;
 
+    // Read the compressed block of the shape at once
+    std::vector<uint8> content(contentSize);
+    {
+        std::ifstream stream(path, std::ios::in | std::ios::binary);
+        stream.seekg(sizeof(uint16_t) * 2 /*Header*/ + shapeFileStart, std::ios::beg);
+        stream.read(reinterpret_cast<char*>(content.data()), contentSize);
         if (!stream.good()) {
-            IG_LOG(L_ERROR) << "Given file '" << path << "' could not extract shape file offset." << std::endl;
+            IG_LOG(L_ERROR) << "Given file '" << path << "' could not read shape " << shapeIndex << "." << std::endl;
             return TriMesh{};
         }
-
-        // Extract mesh file end position
-        if (shapeIndex == shapeCount - 1) {
-            stream.seekg(-std::streamoff(sizeof(shapeCount)), std::ios::end);
-            _shapeFileEnd = stream.tellg();
-        } else {
-            stream.seekg(-std::streamoff(sizeof(shapeCount) + sizeof(_shapeFileEnd) * (shapeCount - shapeIndex + 1)), std::ios::end);
-            stream.read(reinterpret_cast<char*>(&_shapeFileEnd), sizeof(_shapeFileEnd));
-        }
-
-        shapeFileStart = _shapeFileStart;
-        shapeFileEnd   = _shapeFileEnd;
     }
 
-    if (!stream.good()) {
-        IG_LOG(L_ERROR) << "Given file '" << path << "' could not extract shape file offset." << std::endl;
-        return TriMesh{};
-    }
-
-    const size_t maxContentSize = shapeFileEnd - shapeFileStart - sizeof(uint16_t) * 2;
-
-    // Go to start position of mesh
-    stream.seekg(sizeof(uint16_t) * 2 /*Header*/ + shapeFileStart, std::ios::beg);
+    const uint16 fileVersion = dict->Version;
 
     // Inflate with zlib
-    CompressedStream cin(stream, maxContentSize);
+    CompressedStream cin(content.data(), content.size());
 
     uint32_t mesh_flags;
-    cin.read(&mesh_flags);
+    bool good = cin.read(&mesh_flags);
 
     if (fileVersion >= 4) {
-        uint8_t utf8Char;
+        uint8_t utf8Char = 0;
         do {
-            cin.read(&utf8Char);
-        } while (utf8Char != 0); // Ignore shape name
+            good = good && cin.read(&utf8Char);
+        } while (good && utf8Char != 0); // Ignore shape name
     }
 
-    uint64_t vertexCount;
-    uint64_t triCount;
-    cin.read(&vertexCount);
-    cin.read(&triCount);
+    uint64_t vertexCount = 0;
+    uint64_t triCount    = 0;
+    good                 = good && cin.read(&vertexCount) && cin.read(&triCount);
 
-    if (vertexCount == 0 || triCount == 0) {
+    if (!good || vertexCount == 0 || triCount == 0) {
         IG_LOG(L_ERROR) << "Given file '" << path << "' has no valid mesh." << std::endl;
         return TriMesh{};
     }
@@ -282,14 +318,21 @@ TriMesh load(const std::filesystem::path& path, size_t shapeIndex)
     trimesh.indices.resize(triCount * 4);
 
     if (mesh_flags & MF_DOUBLE)
-        extractMeshVertices<double>(trimesh, cin, mesh_flags);
+        good = extractMeshVertices<double>(trimesh, cin, mesh_flags);
     else
-        extractMeshVertices<float>(trimesh, cin, mesh_flags);
+        good = extractMeshVertices<float>(trimesh, cin, mesh_flags);
 
-    if (vertexCount > 0xFFFFFFFF)
-        extractMeshIndices<uint64_t>(trimesh, cin);
-    else
-        extractMeshIndices<uint32_t>(trimesh, cin);
+    if (good) {
+        if (vertexCount > 0xFFFFFFFF)
+            good = extractMeshIndices<uint64_t>(trimesh, cin);
+        else
+            good = extractMeshIndices<uint32_t>(trimesh, cin);
+    }
+
+    if (!good) {
+        IG_LOG(L_ERROR) << "Given file '" << path << "' has a corrupted shape " << shapeIndex << "." << std::endl;
+        return TriMesh{};
+    }
 
     bool hasBadAreas = false;
     trimesh.computeFaceNormals(&hasBadAreas);
@@ -4,7 +4,23 @@
 
 namespace IG {
 namespace mts {
+struct ShapeDictionary;
+
+// Caches the shape offset dictionary per file, such that files referenced multiple times are only scanned once.
+// The cache is thread-safe
+class DictionaryCache {
+public:
+    DictionaryCache();
+    ~DictionaryCache();
+
+    // Returns nullptr if the dictionary could not be loaded
+    std::shared_ptr<const ShapeDictionary> get(const std::filesystem::path& path);
+
+private:
+    std::unique_ptr<struct DictionaryCacheInternal> mInternal;
+};
+
 // Load mesh from Mitsuba serialized format
-TriMesh load(const std::filesystem::path& file, size_t shapeIndex = 0);
+TriMesh load(const std::filesystem::path& file, size_t shapeIndex = 0, DictionaryCache* cache = nullptr);
 } // namespace mts
-} // namespace IG
\ No newline at end of file
+} // namespace IG
@@ -4,10 +4,47 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <set>
+
+#include <tbb/parallel_for.h>
+
 namespace IG {
 namespace obj {
+// Files smaller than this are loaded with the sequential loader, as the overhead is not worth it
+constexpr size_t PARALLEL_THRESHOLD = 16 * 1024 * 1024;
+// Approximate size of a single chunk parsed by one task
+constexpr size_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+static void finalizeMesh(const std::filesystem::path& path, TriMesh& tri_mesh, bool hasNorms, bool hasCoords)
+{
+    // Normals
+    bool hasBadAreas = false;
+    tri_mesh.computeFaceNormals(&hasBadAreas);
+    if (hasBadAreas)
+        IG_LOG(L_WARNING) << "ObjFile " << path << ": Triangle mesh contains triangles with zero area" << std::endl;
+
+    if (hasNorms) {
+        bool hasBadNormals = false;
+        tri_mesh.fixNormals(&hasBadNormals);
+        if (hasBadNormals)
+            IG_LOG(L_WARNING) << "ObjFile " << path << ": Some normals were incorrect and thus had to be replaced with arbitrary values." << std::endl;
+    } else {
+        IG_LOG(L_WARNING) << "ObjFile " << path << ": No valid normals given. Recalculating " << std::endl;
+        tri_mesh.computeVertexNormals();
+    }
+
+    // Texcoords
+    if (!hasCoords) {
+        IG_LOG(L_WARNING) << "ObjFile " << path << ": No texture coordinates are present, using default value." << std::endl;
+        tri_mesh.makeTexCoordsZero();
+    }
+}
+
 // Only partial Wavefront support -> No normal or texcoords indices supported
-TriMesh load(const std::filesystem::path& path)
+TriMesh loadSequential(const std::filesystem::path& path)
 {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
@@ -66,37 +103,380 @@ TriMesh load(const std::filesystem::path& path)
     for (size_t v = 0; v < attrib.vertices.size() / 3; ++v)
         tri_mesh.vertices.emplace_back(attrib.vertices[3 * v + 0], attrib.vertices[3 * v + 1], attrib.vertices[3 * v + 2]);
 
-    // Normals
-    bool hasBadAreas = false;
-    tri_mesh.computeFaceNormals(&hasBadAreas);
-    if (hasBadAreas)
-        IG_LOG(L_WARNING) << "ObjFile " << path << ": Triangle mesh contains triangles with zero area" << std::endl;
-
     if (hasNorms) {
         tri_mesh.normals.reserve(attrib.normals.size() / 3);
         for (size_t v = 0; v < attrib.normals.size() / 3; ++v)
             tri_mesh.normals.emplace_back(attrib.normals[3 * v + 0], attrib.normals[3 * v + 1], attrib.normals[3 * v + 2]);
-
-        bool hasBadNormals = false;
-        tri_mesh.fixNormals(&hasBadNormals);
-        if (hasBadNormals)
-            IG_LOG(L_WARNING) << "ObjFile " << path << ": Some normals were incorrect and thus had to be replaced with arbitrary values." << std::endl;
-    } else {
-        IG_LOG(L_WARNING) << "ObjFile " << path << ": No valid normals given. Recalculating " << std::endl;
-        tri_mesh.computeVertexNormals();
     }
 
-    // Texcoords
     if (hasCoords) {
         tri_mesh.texcoords.reserve(tri_mesh.vertices.size());
         for (size_t v = 0; v < tri_mesh.vertices.size(); ++v)
             tri_mesh.texcoords.emplace_back(attrib.texcoords[2 * v + 0], attrib.texcoords[2 * v + 1]);
-    } else {
-        IG_LOG(L_WARNING) << "ObjFile " << path << ": No texture coordinates are present, using default value." << std::endl;
-        tri_mesh.makeTexCoordsZero();
     }
 
+    finalizeMesh(path, tri_mesh, hasNorms, hasCoords);
     return tri_mesh;
 }
+
+struct MaterialStatement {
+    size_t Face;      // Index of the face following the statement, local to the chunk
+    bool IsLibrary;   // 'mtllib' if true, 'usemtl' otherwise
+    std::string Name; // Rest of the line for 'mtllib', the material name for 'usemtl'
+};
+
+// Data gathered from a single chunk of lines
+struct ObjChunk {
+    const char* Begin;
+    const char* End;
+
+    std::vector<float> Vertices;
+    std::vector<float> Normals;
+    std::vector<float> TexCoords;
+    // Vertex indices of triangulated faces. Negative entries are relative to the start of the chunk, see encodeIndex
+    std::vector<int64> Indices;
+    std::vector<int32> Materials;
+    // 'mtllib' and 'usemtl' statements in order of appearance, which are resolved while merging
+    std::vector<MaterialStatement> MaterialStatements;
+    bool HasMultipleShapes = false;
+    bool HasZeroIndex      = false; // Zero is not a valid index, tinyobj rejects the whole file in that case
+};
+
+inline static bool isSpace(char c) { return c == ' ' || c == '\t'; }
+inline static bool isNewLine(char c) { return c == '\n' || c == '\r' || c == 0; }
+
+inline static const char* skipSpaces(const char* ptr)
+{
+    while (isSpace(*ptr))
+        ++ptr;
+    return ptr;
+}
+
+inline static const char* skipLine(const char* ptr, const char* end)
+{
+    while (ptr < end && *ptr != '\n')
+        ++ptr;
+    return ptr < end ? ptr + 1 : end;
+}
+
+// Missing or malformed values are zero, the same as with tinyobj. Parsing never continues on the next line
+inline static const char* parseFloats(const char* ptr, size_t count, std::vector<float>& out)
+{
+    for (size_t i = 0; i < count; ++i) {
+        ptr = skipSpaces(ptr);
+        if (isNewLine(*ptr)) {
+            out.push_back(0);
+            continue;
+        }
+
+        char* next;
+        out.push_back(std::strtof(ptr, &next));
+        ptr = next;
+    }
+    return ptr;
+}
+
+// Returns the rest of the line without surrounding spaces
+inline static std::string parseRestOfLine(const char* ptr)
+{
+    const char* start = skipSpaces(ptr);
+    const char* it    = start;
+    while (!isNewLine(*it))
+        ++it;
+    while (it > start && isSpace(*(it - 1)))
+        --it;
+    return std::string(start, it);
+}
+
+// Same as the SplitString of tinyobj, which allows to escape spaces with a backslash
+inline static std::vector<std::string> splitLibraries(const std::string& str)
+{
+    std::vector<std::string> names;
+    std::string current;
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (str[i] == '\\' && i + 1 < str.size() && str[i + 1] == ' ') {
+            current += ' ';
+            ++i;
+        } else if (str[i] == ' ') {
+            if (!current.empty())
+                names.push_back(current);
+            current.clear();
+        } else {
+            current += str[i];
+        }
+    }
+    if (!current.empty())
+        names.push_back(current);
+    return names;
+}
+
+// Absolute indices are stored zero based, relative indices are stored biased with respect to the chunk start
+constexpr int64 RELATIVE_INDEX_BIAS = int64(1) << 62;
+inline static int64 encodeIndex(int64 idx, size_t localVertexCount)
+{
+    if (idx > 0)
+        return idx - 1;
+    else
+        return (int64)localVertexCount + idx - RELATIVE_INDEX_BIAS;
+}
+
+inline static int64 decodeIndex(int64 enc, size_t chunkVertexOffset)
+{
+    if (enc >= 0)
+        return enc;
+    else
+        return (int64)chunkVertexOffset + enc + RELATIVE_INDEX_BIAS;
+}
+
+static void parseChunk(ObjChunk& chunk)
+{
+    std::vector<int64> polygon;
+
+    const char* ptr = chunk.Begin;
+    while (ptr < chunk.End) {
+        ptr = skipSpaces(ptr);
+
+        if (ptr[0] == 'v' && isSpace(ptr[1])) {
+            parseFloats(ptr + 2, 3, chunk.Vertices);
+        } else if (ptr[0] == 'v' && ptr[1] == 'n' && isSpace(ptr[2])) {
+            parseFloats(ptr + 3, 3, chunk.Normals);
+        } else if (ptr[0] == 'v' && ptr[1] == 't' && isSpace(ptr[2])) {
+            parseFloats(ptr + 3, 2, chunk.TexCoords);
+        } else if (ptr[0] == 'f' && isSpace(ptr[1])) {
+            // Only the vertex index is of interest, texcoord and normal indices are skipped
+            polygon.clear();
+            const char* it = skipSpaces(ptr + 2);
+            while (!isNewLine(*it)) {
+                char* next;
+                const int64 idx = std::strtoll(it, &next, 10);
+                if (next == it)
+                    break;
+                if (idx == 0)
+                    chunk.HasZeroIndex = true;
+                polygon.push_back(encodeIndex(idx, chunk.Vertices.size() / 3));
+                it = next;
+                while (!isSpace(*it) && !isNewLine(*it))
+                    ++it;
+                it = skipSpaces(it);
+            }
+
+            // Triangulate as a fan
+            for (size_t k = 2; k < polygon.size(); ++k) {
+                chunk.Indices.push_back(polygon[0]);
+                chunk.Indices.push_back(polygon[k - 1]);
+                chunk.Indices.push_back(polygon[k]);
+                chunk.Materials.push_back(-1); // Will be resolved while merging
+            }
+        } else if (std::strncmp(ptr, "usemtl", 6) == 0 && isSpace(ptr[6])) {
+            // Only the first token is the name, the same as with tinyobj
+            const char* start = skipSpaces(ptr + 7);
+            const char* it    = start;
+            while (!isSpace(*it) && !isNewLine(*it))
+                ++it;
+            chunk.MaterialStatements.push_back(MaterialStatement{ chunk.Materials.size(), false, std::string(start, it) });
+        } else if (std::strncmp(ptr, "mtllib", 6) == 0 && isSpace(ptr[6])) {
+            chunk.MaterialStatements.push_back(MaterialStatement{ chunk.Materials.size(), true, parseRestOfLine(ptr + 7) });
+        } else if ((ptr[0] == 'o' || ptr[0] == 'g') && isSpace(ptr[1])) {
+            chunk.HasMultipleShapes = true;
+        }
+
+        ptr = skipLine(ptr, chunk.End);
+    }
+}
+
+// Multi-threaded loader with the same restrictions as the sequential one.
+// The file is split into chunks at line boundaries, which are parsed independently and merged afterwards.
+TriMesh loadParallel(const std::filesystem::path& path)
+{
+    std::ifstream stream(path, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!stream) {
+        IG_LOG(L_ERROR) << "ObjFile " << path << ": Can not be opened" << std::endl;
+        return TriMesh{};
+    }
+
+    const size_t fileSize = (size_t)stream.tellg();
+    stream.seekg(0, std::ios::beg);
+
+    std::vector<char> content(fileSize + 1, 0); // Zero terminated to make strtof safe
+    stream.read(content.data(), fileSize);
+    if (!stream.good()) {
+        IG_LOG(L_ERROR) << "ObjFile " << path << ": Could not read content" << std::endl;
+        return TriMesh{};
+    }
+
+    // Split into chunks
+    std::vector<ObjChunk> chunks;
+    const char* fileBegin = content.data();
+    const char* fileEnd   = content.data() + fileSize;
+    for (const char* ptr = fileBegin; ptr < fileEnd;) {
+        const char* end = ptr + std::min<size_t>(CHUNK_SIZE, fileEnd - ptr);
+        end             = end < fileEnd ? skipLine(end, fileEnd) : fileEnd;
+
+        ObjChunk chunk;
+        chunk.Begin = ptr;
+        chunk.End   = end;
+        chunks.push_back(std::move(chunk));
+        ptr = end;
+    }
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size()),
+                      [&](const tbb::blocked_range<size_t>& range) {
+                          for (size_t i = range.begin(); i != range.end(); ++i)
+                              parseChunk(chunks[i]);
+                      });
+
+    // Compute offsets
+    // The attributes are given in independent lines, which are not necessarily in the same chunks
+    std::vector<size_t> vertexOffsets(chunks.size());
+    std::vector<size_t> normalOffsets(chunks.size());
+    std::vector<size_t> texOffsets(chunks.size());
+    std::vector<size_t> faceOffsets(chunks.size());
+    size_t vertexCount  = 0;
+    size_t normalCount  = 0;
+    size_t texCount     = 0;
+    size_t faceCount    = 0;
+    bool multipleShapes = false;
+    bool zeroIndex      = false;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        vertexOffsets[i] = vertexCount;
+        normalOffsets[i] = normalCount;
+        texOffsets[i]    = texCount;
+        faceOffsets[i]   = faceCount;
+        vertexCount += chunks[i].Vertices.size() / 3;
+        normalCount += chunks[i].Normals.size() / 3;
+        texCount += chunks[i].TexCoords.size() / 2;
+        faceCount += chunks[i].Materials.size();
+        multipleShapes = multipleShapes || chunks[i].HasMultipleShapes;
+        zeroIndex      = zeroIndex || chunks[i].HasZeroIndex;
+    }
+
+    if (zeroIndex) {
+        IG_LOG(L_ERROR) << "ObjFile " << path << ": Failed to parse `f' line (zero value for face index)" << std::endl;
+        return TriMesh{};
+    }
+
+    if (vertexCount == 0) {
+        IG_LOG(L_ERROR) << "ObjFile " << path << ": No vertices given!" << std::endl;
+        return TriMesh{};
+    }
+
+    if (multipleShapes)
+        IG_LOG(L_WARNING) << "ObjFile " << path << ": Contains multiple shapes. Will be combined to one " << std::endl;
+
+    // Resolve material ids through the material libraries, exactly as tinyobj does for the sequential loader.
+    // Libraries are relative to the working directory and unknown materials get the id -1.
+    // The state is carried over from the previous chunk
+    tinyobj::MaterialFileReader materialReader("");
+    std::vector<tinyobj::material_t> materials;
+    std::map<std::string, int> materialMap;
+    std::set<std::string> libraries;
+    int32 currentMaterial = -1;
+
+    const auto applyStatement = [&](const MaterialStatement& statement) {
+        if (statement.IsLibrary) {
+            const auto names = splitLibraries(statement.Name);
+            bool found       = false;
+            for (const auto& name : names) {
+                if (libraries.count(name) > 0) {
+                    found = true;
+                    continue;
+                }
+
+                std::string warn;
+                std::string err;
+                if (materialReader(name, &materials, &materialMap, &warn, &err)) {
+                    found = true;
+                    libraries.insert(name);
+                    break;
+                }
+            }
+            if (!found)
+                IG_LOG(L_WARNING) << "ObjFile " << path << ": Failed to load material file(s). Use default material." << std::endl;
+        } else {
+            const auto it = materialMap.find(statement.Name);
+            if (it != materialMap.end()) {
+                currentMaterial = it->second;
+            } else {
+                IG_LOG(L_WARNING) << "ObjFile " << path << ": material [ '" << statement.Name << "' ] not found in .mtl" << std::endl;
+                currentMaterial = -1;
+            }
+        }
+    };
+
+    for (auto& chunk : chunks) {
+        size_t statement = 0;
+        for (size_t f = 0; f < chunk.Materials.size(); ++f) {
+            for (; statement < chunk.MaterialStatements.size() && chunk.MaterialStatements[statement].Face == f; ++statement)
+                applyStatement(chunk.MaterialStatements[statement]);
+            chunk.Materials[f] = currentMaterial;
+        }
+        for (; statement < chunk.MaterialStatements.size(); ++statement)
+            applyStatement(chunk.MaterialStatements[statement]);
+    }
+
+    const bool hasNorms  = normalCount == vertexCount;
+    const bool hasCoords = texCount == vertexCount;
+
+    TriMesh tri_mesh;
+    tri_mesh.vertices.resize(vertexCount);
+    tri_mesh.indices.resize(faceCount * 4);
+    if (hasNorms)
+        tri_mesh.normals.resize(normalCount);
+    if (hasCoords)
+        tri_mesh.texcoords.resize(texCount);
+
+    // Merge
+    std::atomic<bool> hasBadIndices = false;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, chunks.size()),
+                      [&](const tbb::blocked_range<size_t>& range) {
+                          for (size_t i = range.begin(); i != range.end(); ++i) {
+                              const ObjChunk& chunk = chunks[i];
+                              const size_t voff     = vertexOffsets[i];
+                              const size_t noff     = normalOffsets[i];
+                              const size_t toff     = texOffsets[i];
+                              const size_t foff     = faceOffsets[i];
+
+                              for (size_t v = 0; v < chunk.Vertices.size() / 3; ++v)
+                                  tri_mesh.vertices[voff + v] = Vector3f(chunk.Vertices[3 * v + 0], chunk.Vertices[3 * v + 1], chunk.Vertices[3 * v + 2]);
+                              if (hasNorms) {
+                                  for (size_t v = 0; v < chunk.Normals.size() / 3; ++v)
+                                      tri_mesh.normals[noff + v] = Vector3f(chunk.Normals[3 * v + 0], chunk.Normals[3 * v + 1], chunk.Normals[3 * v + 2]);
+                              }
+                              if (hasCoords) {
+                                  for (size_t v = 0; v < chunk.TexCoords.size() / 2; ++v)
+                                      tri_mesh.texcoords[toff + v] = Vector2f(chunk.TexCoords[2 * v + 0], chunk.TexCoords[2 * v + 1]);
+                              }
+
+                              for (size_t f = 0; f < chunk.Materials.size(); ++f) {
+                                  for (size_t k = 0; k < 3; ++k) {
+                                      const int64 idx = decodeIndex(chunk.Indices[3 * f + k], voff);
+                                      if (idx < 0 || idx >= (int64)vertexCount) {
+                                          hasBadIndices = true;
+                                          tri_mesh.indices[4 * (foff + f) + k] = 0;
+                                      } else {
+                                          tri_mesh.indices[4 * (foff + f) + k] = (uint32)idx;
+                                      }
+                                  }
+                                  tri_mesh.indices[4 * (foff + f) + 3] = (uint32)chunk.Materials[f]; // Last entry is material index
+                              }
+                          }
+                      });
+
+    if (hasBadIndices)
+        IG_LOG(L_WARNING) << "ObjFile " << path << ": Some indices are out of bounds and were replaced by zero." << std::endl;
+
+    finalizeMesh(path, tri_mesh, hasNorms, hasCoords);
+    return tri_mesh;
+}
+
+TriMesh load(const std::filesystem::path& path)
+{
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(path, ec);
+    if (!ec && size >= PARALLEL_THRESHOLD)
+        return loadParallel(path);
+    else
+        return loadSequential(path);
+}
 } // namespace obj
 } // namespace IG
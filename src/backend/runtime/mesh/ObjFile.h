@@ -5,7 +5,10 @@
 namespace IG {
 namespace obj {
 
+// Loads with the sequential loader for small files and with the parallel loader otherwise
 TriMesh load(const std::filesystem::path& path);
+TriMesh loadSequential(const std::filesystem::path& path);
+TriMesh loadParallel(const std::filesystem::path& path);
 
 }
 } // namespace IG
@@ -1,5 +1,9 @@
 #include "TriMesh.h"
 #include "Tangent.h"
+#include "math/BoundingBox.h"
+
+#include <numeric>
+#include <unordered_map>
 
 namespace IG {
 
@@ -432,4 +436,172 @@ TriMesh TriMesh::MakeCylinder(const Vector3f& baseCenter, float baseRadius, cons
     return mesh;
 }
 
+struct WeldKey {
+    std::array<uint32, 8> Data;
+
+    inline bool operator==(const WeldKey& other) const { return Data == other.Data; }
+};
+
+struct WeldKeyHash {
+    inline size_t operator()(const WeldKey& key) const
+    {
+        size_t seed = 0;
+        for (uint32 v : key.Data)
+            seed ^= std::hash<uint32>()(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        return seed;
+    }
+};
+
+size_t TriMesh::weldVertices()
+{
+    const size_t vertexCount = vertices.size();
+    const bool hasNormals    = normals.size() >= vertexCount;
+    const bool hasTexCoords  = texcoords.size() >= vertexCount;
+
+    // Attributes with an unexpected count can not be welded safely
+    if ((!normals.empty() && !hasNormals) || (!texcoords.empty() && !hasTexCoords))
+        return 0;
+
+    const auto bits = [](float f) {
+        f = f == 0.0f ? 0.0f : f; // Handle -0
+        uint32 b;
+        std::memcpy(&b, &f, sizeof(b));
+        return b;
+    };
+
+    std::unordered_map<WeldKey, uint32, WeldKeyHash> map;
+    map.reserve(vertexCount);
+
+    std::vector<uint32> remap(vertexCount);
+    std::vector<StVector3f> new_vertices;
+    std::vector<StVector3f> new_normals;
+    std::vector<StVector2f> new_texcoords;
+    new_vertices.reserve(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i) {
+        WeldKey key;
+        key.Data.fill(0);
+        key.Data[0] = bits(vertices[i](0));
+        key.Data[1] = bits(vertices[i](1));
+        key.Data[2] = bits(vertices[i](2));
+        if (hasNormals) {
+            key.Data[3] = bits(normals[i](0));
+            key.Data[4] = bits(normals[i](1));
+            key.Data[5] = bits(normals[i](2));
+        }
+        if (hasTexCoords) {
+            key.Data[6] = bits(texcoords[i](0));
+            key.Data[7] = bits(texcoords[i](1));
+        }
+
+        const auto it = map.try_emplace(key, (uint32)new_vertices.size());
+        if (it.second) {
+            new_vertices.push_back(vertices[i]);
+            if (hasNormals)
+                new_normals.push_back(normals[i]);
+            if (hasTexCoords)
+                new_texcoords.push_back(texcoords[i]);
+        }
+        remap[i] = it.first->second;
+    }
+
+    for (size_t i = 0; i < indices.size(); i += 4) {
+        indices[i + 0] = remap[indices[i + 0]];
+        indices[i + 1] = remap[indices[i + 1]];
+        indices[i + 2] = remap[indices[i + 2]];
+    }
+
+    const size_t removed = vertexCount - new_vertices.size();
+    vertices             = std::move(new_vertices);
+    if (hasNormals)
+        normals = std::move(new_normals);
+    if (hasTexCoords)
+        texcoords = std::move(new_texcoords);
+    return removed;
+}
+
+inline static uint32 expandBits(uint32 v)
+{
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+inline static uint32 mortonCode(const Vector3f& p)
+{
+    const auto quantize = [](float f) { return (uint32)std::min(std::max(f * 1024.0f, 0.0f), 1023.0f); };
+    return (expandBits(quantize(p(0))) << 2) | (expandBits(quantize(p(1))) << 1) | expandBits(quantize(p(2)));
+}
+
+void TriMesh::reorderForLocality()
+{
+    const size_t fCount = faceCount();
+    if (fCount == 0)
+        return;
+
+    BoundingBox bbox = BoundingBox::Empty();
+    for (const auto& v : vertices)
+        bbox.extend(v);
+    const Vector3f extent = bbox.diameter().cwiseMax(Vector3f::Constant(FltEps));
+
+    // Sort faces along a morton curve of their centroids
+    std::vector<uint32> codes(fCount);
+    for (size_t f = 0; f < fCount; ++f) {
+        const Vector3f c = (vertices[indices[4 * f + 0]] + vertices[indices[4 * f + 1]] + vertices[indices[4 * f + 2]]) / 3.0f;
+        codes[f]         = mortonCode((c - bbox.min).cwiseQuotient(extent));
+    }
+
+    std::vector<uint32> order(fCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32 a, uint32 b) { return codes[a] < codes[b]; });
+
+    std::vector<uint32> new_indices(indices.size());
+    std::vector<StVector3f> new_face_normals(face_normals.size());
+    std::vector<float> new_face_inv_area(face_inv_area.size());
+    for (size_t f = 0; f < fCount; ++f) {
+        const uint32 old = order[f];
+        for (size_t k = 0; k < 4; ++k)
+            new_indices[4 * f + k] = indices[4 * old + k];
+        if (old < face_normals.size())
+            new_face_normals[f] = face_normals[old];
+        if (old < face_inv_area.size())
+            new_face_inv_area[f] = face_inv_area[old];
+    }
+    indices       = std::move(new_indices);
+    face_normals  = std::move(new_face_normals);
+    face_inv_area = std::move(new_face_inv_area);
+
+    // Renumber vertices in order of their first use. Unreferenced vertices are dropped
+    const size_t vertexCount = vertices.size();
+    const bool hasNormals    = normals.size() >= vertexCount;
+    const bool hasTexCoords  = texcoords.size() >= vertexCount;
+
+    constexpr uint32 Unused = 0xFFFFFFFF;
+    std::vector<uint32> remap(vertexCount, Unused);
+    std::vector<StVector3f> new_vertices;
+    std::vector<StVector3f> new_normals;
+    std::vector<StVector2f> new_texcoords;
+    new_vertices.reserve(vertexCount);
+    for (size_t i = 0; i < indices.size(); i += 4) {
+        for (size_t k = 0; k < 3; ++k) {
+            uint32& id = indices[i + k];
+            if (remap[id] == Unused) {
+                remap[id] = (uint32)new_vertices.size();
+                new_vertices.push_back(vertices[id]);
+                if (hasNormals)
+                    new_normals.push_back(normals[id]);
+                if (hasTexCoords)
+                    new_texcoords.push_back(texcoords[id]);
+            }
+            id = remap[id];
+        }
+    }
+
+    vertices = std::move(new_vertices);
+    if (hasNormals)
+        normals = std::move(new_normals);
+    if (hasTexCoords)
+        texcoords = std::move(new_texcoords);
+}
 } // namespace IG
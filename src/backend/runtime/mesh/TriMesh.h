@@ -34,6 +34,11 @@ struct TriMesh {
     void makeTexCoordsZero();
     void setupFaceNormalsAsVertexNormals();
 
+    // Merge vertices with the same position, normal and texture coordinate. Returns number of removed vertices
+    size_t weldVertices();
+    // Reorder faces in spatial order and vertices in order of their first use to improve memory locality
+    void reorderForLocality();
+
     static TriMesh MakeSphere(const Vector3f& center, float radius, uint32 stacks, uint32 slices);
     static TriMesh MakeDisk(const Vector3f& center, const Vector3f& normal, float radius, uint32 sections);
     static TriMesh MakePlane(const Vector3f& origin, const Vector3f& xAxis, const Vector3f& yAxis);
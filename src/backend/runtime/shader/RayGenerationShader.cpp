@@ -9,6 +9,18 @@
 namespace IG {
 using namespace Parser;
 
+static std::string generatePixelSampler(const LoaderContext& ctx)
+{
+    if (ctx.PixelSamplerType == "sobol")
+        return "make_sobol_pixel_sampler()";
+    else if (ctx.PixelSamplerType == "mjitt")
+        return "make_mjitt_pixel_sampler(4, 4)";
+
+    if (!ctx.PixelSamplerType.empty() && ctx.PixelSamplerType != "uniform")
+        IG_LOG(L_WARNING) << "Unknown pixel sampler '" << ctx.PixelSamplerType << "'. Using uniform sampler instead" << std::endl;
+    return "make_uniform_pixel_sampler()";
+}
+
 std::string RayGenerationShader::setup(LoaderContext& ctx)
 {
     std::stringstream stream;
@@ -31,7 +43,7 @@ std::string RayGenerationShader::setup(LoaderContext& ctx)
         return {};
     }
 
-    if (!gen.empty()) {
+    if (!gen.empty() && ctx.CameraCount <= 1) {
         stream << "  let camera = " << gen << "(" << std::endl
                << "    settings.eye," << std::endl
                << "    make_mat3x3(settings.right, settings.up, settings.dir)," << std::endl
@@ -46,9 +58,20 @@ std::string RayGenerationShader::setup(LoaderContext& ctx)
     stream << "  let spp = " << ctx.SamplesPerIteration << " : i32;" << std::endl;
     if (ctx.CameraType == "list") {
         stream << "  let emitter = make_list_emitter(device.load_rays(), iter, init_raypayload);" << std::endl;
+    } else if (ctx.CameraCount > 1) {
+        // Views are packed as eye, dir, up, right, width, height, tmin, tmax. Has to be in sync with Runtime.cpp
+        stream << "  let (views, view_count) = device.load_camera_views();" << std::endl
+               << "  let load_view_vec3 = @|i: i32| make_vec3(views.load_f32(i + 0), views.load_f32(i + 1), views.load_f32(i + 2));" << std::endl // Not aligned for vector loads
+               << "  let cameras = @|view: i32| {" << std::endl
+               << "    let b = view * 16;" << std::endl
+               << "    " << gen << "(load_view_vec3(b + 0)," << std::endl
+               << "      make_mat3x3(load_view_vec3(b + 9), load_view_vec3(b + 6), load_view_vec3(b + 3))," << std::endl
+               << "      views.load_f32(b + 12), views.load_f32(b + 13), views.load_f32(b + 14), views.load_f32(b + 15))" << std::endl
+               << "  };" << std::endl
+               << "  let emitter = make_multi_camera_emitter(cameras, view_count, iter, spp, " << generatePixelSampler(ctx) << ", init_raypayload);" << std::endl;
     } else {
         IG_ASSERT(!gen.empty(), "Generator function can not be empty!");
-        stream << "  let emitter = make_camera_emitter(camera, iter, spp, make_uniform_pixel_sampler()/*make_mjitt_pixel_sampler(4,4)*/, init_raypayload);" << std::endl;
+        stream << "  let emitter = make_camera_emitter(camera, iter, spp, " << generatePixelSampler(ctx) << ", init_raypayload);" << std::endl;
     }
 
     stream << "  device.generate_rays(emitter, id, size, xmin, ymin, xmax, ymax, spp)" << std::endl
@@ -4,6 +4,8 @@
 #include "model/ArHosekSkyModel.h"
 #include "serialization/Serializer.h"
 
+#include <tbb/parallel_for.h>
+
 namespace IG {
 SkyModel::SkyModel(const RGB& ground_albedo, const ElevationAzimuth& sunEA, float turbidity, size_t resAzimuth, size_t resElevation)
     : mAzimuthCount(resAzimuth)
@@ -19,28 +21,32 @@ SkyModel::SkyModel(const RGB& ground_albedo, const ElevationAzimuth& sunEA, floa
     for (size_t k = 0; k < AR_COLOR_BANDS; ++k) {
         const float albedo = ground_albedo[k];
 
+        // The state is only read while evaluating, rows can be computed in parallel
         auto* state = arhosek_rgb_skymodelstate_alloc_init(atmospheric_turbidity, albedo, solar_elevation);
-        for (size_t y = 0; y < mElevationCount; ++y) {
-            const float theta = std::max(0.001f, ELEVATION_RANGE * y / (float)mElevationCount) - Pi2;
-            const float st    = std::sin(theta);
-            const float ct    = std::cos(theta);
-            for (size_t x = 0; x < mAzimuthCount; ++x) {
-                const float azimuth = AZIMUTH_RANGE * x / (float)mAzimuthCount;
-
-                float cosGamma = ct * sun_ce + st * sun_se * std::cos(azimuth - sunEA.Azimuth);
-                float gamma    = std::acos(std::min(1.0f, std::max(-1.0f, cosGamma)));
-                float radiance = arhosek_tristim_skymodel_radiance(state, theta, gamma, k);
-
-                mData[y * mAzimuthCount * 4 + x * 4 + k] = std::max(0.0f, radiance);
-            }
-        }
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, mElevationCount),
+                          [&](const tbb::blocked_range<size_t>& range) {
+                              for (size_t y = range.begin(); y != range.end(); ++y) {
+                                  const float theta = std::max(0.001f, ELEVATION_RANGE * y / (float)mElevationCount) - Pi2;
+                                  const float st    = std::sin(theta);
+                                  const float ct    = std::cos(theta);
+                                  for (size_t x = 0; x < mAzimuthCount; ++x) {
+                                      const float azimuth = AZIMUTH_RANGE * x / (float)mAzimuthCount;
+
+                                      float cosGamma = ct * sun_ce + st * sun_se * std::cos(azimuth - sunEA.Azimuth);
+                                      float gamma    = std::acos(std::min(1.0f, std::max(-1.0f, cosGamma)));
+                                      float radiance = arhosek_tristim_skymodel_radiance(state, theta, gamma, k);
+
+                                      mData[y * mAzimuthCount * 4 + x * 4 + k] = std::max(0.0f, radiance);
+                                  }
+                              }
+                          });
 
         arhosekskymodelstate_free(state);
     }
 }
 
-void SkyModel::save(const std::filesystem::path& path) const
+bool SkyModel::save(const std::filesystem::path& path) const
 {
-    ImageRgba32::save(path, mData.data(), mAzimuthCount, mElevationCount);
+    return ImageRgba32::save(path, mData.data(), mAzimuthCount, mElevationCount);
 }
 } // namespace IG
\ No newline at end of file
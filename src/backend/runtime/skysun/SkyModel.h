@@ -27,7 +27,7 @@ public:
         };
     }
 
-    void save(const std::filesystem::path& path) const;
+    bool save(const std::filesystem::path& path) const;
 
 private:
     std::vector<float> mData;
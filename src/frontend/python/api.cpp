@@ -6,12 +6,134 @@
 #include "Camera.h"
 #include "Runtime.h"
 
+#include <future>
+
 #define STRINGIFY(x) #x
 #define MACRO_STRINGIFY(x) STRINGIFY(x)
 
 namespace py = pybind11;
 using namespace IG;
 
+using FloatArray = py::array_t<float, py::array::c_style | py::array::forcecast>;
+
+static inline void check_ray_array(const FloatArray& array, const char* name, size_t count, size_t components)
+{
+    if (array.ndim() != 2 || (size_t)array.shape(0) != count || (size_t)array.shape(1) != components)
+        throw std::invalid_argument(std::string("Expected '") + name + "' to be of shape (" + std::to_string(count) + ", " + std::to_string(components) + ")");
+}
+
+// Trace rays given as (N,3) origins, (N,3) directions and optional (N,2) ranges without creating per-ray python objects
+static py::array_t<float> trace_numpy(Runtime& runtime, const FloatArray& origins, const FloatArray& directions, const std::optional<FloatArray>& ranges, uint32 iterations)
+{
+    const size_t count = origins.ndim() > 0 ? (size_t)origins.shape(0) : 0;
+    check_ray_array(origins, "origins", count, 3);
+    check_ray_array(directions, "directions", count, 3);
+    if (ranges.has_value())
+        check_ray_array(ranges.value(), "ranges", count, 2);
+
+    py::array_t<float> result({ count, (size_t)3 });
+
+    const float* org = origins.data();
+    const float* dir = directions.data();
+    const float* rng = ranges.has_value() ? ranges.value().data() : nullptr;
+    float* radiance  = result.mutable_data();
+
+    {
+        // The numpy arrays are not touched by python while tracing
+        py::gil_scoped_release release;
+
+        // The runtime expects a structure of arrays
+        std::vector<float> soa(count * 8);
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t k = 0; k < 3; ++k) {
+                soa[k * count + i]       = org[i * 3 + k];
+                soa[(k + 3) * count + i] = dir[i * 3 + k];
+            }
+
+            const float tmin   = rng ? rng[i * 2 + 0] : 0.0f;
+            const float tmax   = rng ? rng[i * 2 + 1] : FltMax;
+            soa[6 * count + i] = tmin;
+            soa[7 * count + i] = tmax <= tmin ? FltMax : tmax;
+        }
+
+        RayBatch batch;
+        batch.OriginX    = soa.data() + 0 * count;
+        batch.OriginY    = soa.data() + 1 * count;
+        batch.OriginZ    = soa.data() + 2 * count;
+        batch.DirectionX = soa.data() + 3 * count;
+        batch.DirectionY = soa.data() + 4 * count;
+        batch.DirectionZ = soa.data() + 5 * count;
+        batch.TMin       = soa.data() + 6 * count;
+        batch.TMax       = soa.data() + 7 * count;
+        batch.Count      = count;
+
+        runtime.trace(batch, radiance, iterations);
+    }
+
+    return result;
+}
+
+// Handle to a runtime call running in the background. The runtime must not be used otherwise until the call finished
+class RuntimeFuture {
+public:
+    inline RuntimeFuture(std::shared_future<void>&& future, const py::object& owner)
+        : mOwner(owner)
+        , mFuture(std::move(future))
+    {
+    }
+
+    // Only movable, such that exactly one object waits for the call
+    RuntimeFuture(RuntimeFuture&&) = default;
+    RuntimeFuture(const RuntimeFuture&) = delete;
+    RuntimeFuture& operator=(const RuntimeFuture&) = delete;
+
+    // Wait for the call without holding the GIL before the runtime is released, as the runtime has to outlive the call.
+    // A moved-from object has no valid future and does not wait
+    inline ~RuntimeFuture()
+    {
+        if (mFuture.valid()) {
+            py::gil_scoped_release release;
+            mFuture.wait();
+        }
+    }
+
+    inline bool done() const
+    {
+        return mFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    // Wait until the call finished. Rethrows exceptions thrown by the call
+    inline void result() const
+    {
+        {
+            py::gil_scoped_release release;
+            mFuture.wait();
+        }
+        mFuture.get();
+    }
+
+private:
+    py::object mOwner; // Keep the runtime alive while the call is running. Declared first, such that it is released last
+    std::shared_future<void> mFuture;
+};
+
+// Copy the given aov into a preallocated, c-contiguous float32 numpy array of shape (height, width, 3)
+static void copy_framebuffer(const Runtime& runtime, py::array& out, uint32 aov)
+{
+    const size_t width  = runtime.framebufferWidth();
+    const size_t height = runtime.framebufferHeight();
+
+    if (!out.dtype().is(py::dtype::of<float>()) || !(out.flags() & py::array::c_style) || !out.writeable())
+        throw std::invalid_argument("Expected a writeable, c-contiguous float32 array");
+    if (out.ndim() != 3 || (size_t)out.shape(0) != height || (size_t)out.shape(1) != width || out.shape(2) != 3)
+        throw std::invalid_argument("Expected an array of shape (" + std::to_string(height) + ", " + std::to_string(width) + ", 3)");
+
+    float* dst = static_cast<float*>(out.mutable_data());
+
+    py::gil_scoped_release release;
+    std::memcpy(dst, runtime.getFramebuffer(aov), sizeof(float) * width * height * 3);
+}
+
 PYBIND11_MODULE(pyignis, m)
 {
     m.doc() = R"pbdoc(
@@ -29,12 +151,31 @@ PYBIND11_MODULE(pyignis, m)
         .def_readwrite("DesiredTarget", &RuntimeOptions::DesiredTarget)
         .def_readwrite("Device", &RuntimeOptions::Device)
         .def_readwrite("OverrideCamera", &RuntimeOptions::OverrideCamera)
-        .def_readwrite("OverrideTechnique", &RuntimeOptions::OverrideTechnique);
+        .def_readwrite("CameraCount", &RuntimeOptions::CameraCount)
+        .def_readwrite("AdaptiveError", &RuntimeOptions::AdaptiveError)
+        .def_readwrite("OverrideTechnique", &RuntimeOptions::OverrideTechnique)
+        .def_readwrite("OverridePixelSampler", &RuntimeOptions::OverridePixelSampler)
+        .def_readwrite("Denoise", &RuntimeOptions::Denoise)
+        .def_readwrite("CacheDir", &RuntimeOptions::CacheDir)
+        .def_readwrite("SPI", &RuntimeOptions::SPI);
+
+    py::class_<DenoiserSettings>(m, "DenoiserSettings")
+        .def(py::init([]() { return DenoiserSettings(); }))
+        .def_readwrite("Iterations", &DenoiserSettings::Iterations)
+        .def_readwrite("ColorSigma", &DenoiserSettings::ColorSigma)
+        .def_readwrite("NormalSigma", &DenoiserSettings::NormalSigma)
+        .def_readwrite("DepthSigma", &DenoiserSettings::DepthSigma);
 
     py::class_<RuntimeRenderSettings>(m, "RuntimeRenderSettings")
         .def(py::init([]() { return RuntimeRenderSettings(); }))
         .def_readwrite("FilmWidth", &RuntimeRenderSettings::FilmWidth)
-        .def_readwrite("FilmHeight", &RuntimeRenderSettings::FilmHeight);
+        .def_readwrite("FilmHeight", &RuntimeRenderSettings::FilmHeight)
+        .def_readwrite("CameraEye", &RuntimeRenderSettings::CameraEye)
+        .def_readwrite("CameraDir", &RuntimeRenderSettings::CameraDir)
+        .def_readwrite("CameraUp", &RuntimeRenderSettings::CameraUp)
+        .def_readwrite("FOV", &RuntimeRenderSettings::FOV)
+        .def_readwrite("TMin", &RuntimeRenderSettings::TMin)
+        .def_readwrite("TMax", &RuntimeRenderSettings::TMax);
 
     py::class_<Camera>(m, "Camera")
         .def(py::init([](const Vector3f& e, const Vector3f& d, const Vector3f& u, float fov, float ratio, float tmin, float tmax) { return Camera(e, d, u, fov, ratio, tmin, tmax); }))
@@ -62,26 +203,78 @@ PYBIND11_MODULE(pyignis, m)
         .value("NVVM", Target::NVVM)
         .value("AMDGPU", Target::AMDGPU);
 
+    py::class_<RuntimeFuture>(m, "RuntimeFuture")
+        .def("done", &RuntimeFuture::done)
+        .def("result", &RuntimeFuture::result);
+
     py::class_<Runtime>(m, "Runtime")
         .def(py::init([](const std::string& path) { return std::make_unique<Runtime>(path, RuntimeOptions()); }))
         .def(py::init([](const std::string& path, const RuntimeOptions& opts) { return std::make_unique<Runtime>(path, opts); }))
-        .def("setup", &Runtime::setup)
-        .def("step", &Runtime::step)
+        .def("setup", &Runtime::setup, py::call_guard<py::gil_scoped_release>())
+        .def("step", py::overload_cast<const Camera&>(&Runtime::step), py::call_guard<py::gil_scoped_release>())
+        .def("step", py::overload_cast<const std::vector<Camera>&>(&Runtime::step), py::call_guard<py::gil_scoped_release>())
+        .def("stepAsync", [](py::object self, const Camera& camera) {
+            Runtime* runtime = self.cast<Runtime*>();
+            std::shared_future<void> future = std::async(std::launch::async, [runtime, camera]() { runtime->step(camera); }).share();
+            return RuntimeFuture(std::move(future), self);
+        })
         .def("trace", [](Runtime& r, const std::vector<Ray>& rays) {
             std::vector<float> data;
-            r.trace(rays, data);
+            {
+                py::gil_scoped_release release;
+                r.trace(rays, data);
+            }
             return data;
         })
+        .def("trace_numpy", &trace_numpy,
+             py::arg("origins"), py::arg("directions"), py::arg("ranges") = py::none(), py::arg("iterations") = 1)
         .def("getFramebuffer", [](const Runtime& r, uint32 aov) {
-            const size_t width  = r.loadedRenderSettings().FilmWidth;
-            const size_t height = r.loadedRenderSettings().FilmHeight;
+            const size_t width  = r.framebufferWidth();
+            const size_t height = r.framebufferHeight();
             return py::memoryview::from_buffer(
                 r.getFramebuffer(aov),                                          // buffer pointer
                 { height, width, 3ul },                                         // shape (rows, cols)
                 { sizeof(float) * width * 3, sizeof(float) * 3, sizeof(float) } // strides in bytes
             );
         })
+        .def("getCameraFramebuffer", [](const Runtime& r, uint32 camera, uint32 aov) {
+            if (camera >= r.cameraCount())
+                throw std::out_of_range("Invalid camera index");
+            const size_t width  = r.framebufferWidth();
+            const size_t height = r.framebufferHeight() / r.cameraCount();
+            return py::memoryview::from_buffer(
+                r.getCameraFramebuffer(camera, aov),                            // buffer pointer
+                { height, width, 3ul },                                         // shape (rows, cols)
+                { sizeof(float) * width * 3, sizeof(float) * 3, sizeof(float) } // strides in bytes
+            );
+        },
+             py::arg("camera"), py::arg("aov") = 0)
+        .def("copyFramebuffer", &copy_framebuffer, py::arg("out"), py::arg("aov") = 0)
+        .def("denoise", [](Runtime& r, const DenoiserSettings& settings) {
+            const float* denoised;
+            {
+                py::gil_scoped_release release;
+                denoised = r.denoise(settings);
+            }
+            if (!denoised)
+                throw std::runtime_error("Denoiser is not enabled, set the Denoise option");
+
+            const size_t width  = r.framebufferWidth();
+            const size_t height = r.framebufferHeight();
+            return py::memoryview::from_buffer(
+                denoised,                                                       // buffer pointer
+                { height, width, 3ul },                                         // shape (rows, cols)
+                { sizeof(float) * width * 3, sizeof(float) * 3, sizeof(float) } // strides in bytes
+            );
+        },
+             py::arg("settings") = DenoiserSettings())
         .def("clearFramebuffer", &Runtime::clearFramebuffer)
+        .def("saveFilm", [](const Runtime& r, const std::string& path) { return r.saveFilm(path); })
+        .def("loadFilm", [](Runtime& r, const std::string& path) { return r.loadFilm(path); })
         .def_property_readonly("iterationCount", &Runtime::currentIterationCount)
+        .def_property_readonly("filmIterationCount", &Runtime::currentFilmIterationCount)
+        .def_property_readonly("cameraCount", &Runtime::cameraCount)
+        .def_property_readonly("hasDenoiser", &Runtime::hasDenoiser)
+        .def_property("seedOffset", &Runtime::seedOffset, &Runtime::setSeedOffset)
         .def_property_readonly("loadedRenderSettings", &Runtime::loadedRenderSettings);
 }
\ No newline at end of file
@@ -0,0 +1,237 @@
+#include "RayIO.h"
+#include "Logger.h"
+
+#include <fstream>
+#include <sstream>
+
+#ifdef IG_OS_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace IG {
+inline static Ray makeRay(const float* record)
+{
+    Ray ray;
+    ray.Origin    = Vector3f(record[0], record[1], record[2]);
+    ray.Direction = Vector3f(record[3], record[4], record[5]);
+    ray.Range     = Vector2f(record[6], record[7]);
+
+    if (ray.Range(1) <= ray.Range(0))
+        ray.Range(1) = std::numeric_limits<float>::max();
+    return ray;
+}
+
+class TextRayReader : public RayReader {
+public:
+    inline TextRayReader(std::istream& stream, bool interactive)
+        : mStream(stream)
+        , mInteractive(interactive)
+        , mDone(false)
+    {
+    }
+
+    size_t read(std::vector<Ray>& rays, size_t maxCount) override
+    {
+        rays.clear();
+
+        std::string line;
+        while (!mDone && (maxCount == 0 || rays.size() < maxCount)) {
+            if (mInteractive)
+                std::cout << ">> ";
+
+            if (!std::getline(mStream, line) || line.empty()) {
+                mDone = true;
+                break;
+            }
+
+            std::stringstream stream(line);
+
+            float record[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+            for (int i = 0; i < 8; ++i)
+                stream >> record[i];
+
+            rays.push_back(makeRay(record));
+        }
+
+        return rays.size();
+    }
+
+private:
+    std::istream& mStream;
+    const bool mInteractive;
+    bool mDone;
+};
+
+class BinaryRayReader : public RayReader {
+public:
+    inline explicit BinaryRayReader(std::istream& stream)
+        : mStream(stream)
+    {
+    }
+
+    size_t read(std::vector<Ray>& rays, size_t maxCount) override
+    {
+        constexpr size_t ChunkSize = 4096; // Rays read at once if no maximum is given
+
+        rays.clear();
+        while (mStream && (maxCount == 0 || rays.size() < maxCount)) {
+            const size_t count = maxCount == 0 ? ChunkSize : std::min(ChunkSize, maxCount - rays.size());
+            mBuffer.resize(count * 8);
+            mStream.read(reinterpret_cast<char*>(mBuffer.data()), count * BinaryRayRecordSize);
+
+            const size_t read = (size_t)mStream.gcount() / BinaryRayRecordSize;
+            if (read * BinaryRayRecordSize != (size_t)mStream.gcount())
+                IG_LOG(L_WARNING) << "Input contains an incomplete ray record, ignoring it" << std::endl;
+
+            for (size_t i = 0; i < read; ++i)
+                rays.push_back(makeRay(&mBuffer[i * 8]));
+        }
+
+        return rays.size();
+    }
+
+private:
+    std::istream& mStream;
+    std::vector<float> mBuffer;
+};
+
+#ifdef IG_OS_LINUX
+class MappedRayReader : public RayReader {
+public:
+    inline MappedRayReader(const float* data, size_t size)
+        : mData(data)
+        , mSize(size)
+        , mCount(size / BinaryRayRecordSize)
+        , mCurrent(0)
+    {
+        if (mCount * BinaryRayRecordSize != size)
+            IG_LOG(L_WARNING) << "Input contains an incomplete ray record, ignoring it" << std::endl;
+
+        // Rays are consumed from front to back
+        madvise(const_cast<float*>(mData), mSize, MADV_SEQUENTIAL);
+    }
+
+    ~MappedRayReader()
+    {
+        munmap(const_cast<float*>(mData), mSize);
+    }
+
+    size_t read(std::vector<Ray>& rays, size_t maxCount) override
+    {
+        const size_t count = maxCount == 0 ? mCount - mCurrent : std::min(maxCount, mCount - mCurrent);
+
+        rays.resize(count);
+        for (size_t i = 0; i < count; ++i)
+            rays[i] = makeRay(mData + (mCurrent + i) * 8);
+
+        mCurrent += count;
+        return count;
+    }
+
+private:
+    const float* mData;
+    const size_t mSize;
+    const size_t mCount;
+    size_t mCurrent;
+};
+#endif
+
+// Keeps the stream alive for the fallback reader
+class OwningBinaryRayReader : public BinaryRayReader {
+public:
+    inline explicit OwningBinaryRayReader(std::unique_ptr<std::ifstream>&& stream)
+        : BinaryRayReader(*stream)
+        , mStream(std::move(stream))
+    {
+    }
+
+private:
+    std::unique_ptr<std::ifstream> mStream;
+};
+
+std::unique_ptr<RayReader> RayReader::createText(std::istream& stream, bool interactive)
+{
+    return std::make_unique<TextRayReader>(stream, interactive);
+}
+
+std::unique_ptr<RayReader> RayReader::createBinary(std::istream& stream)
+{
+    return std::make_unique<BinaryRayReader>(stream);
+}
+
+std::unique_ptr<RayReader> RayReader::createMapped(const std::filesystem::path& path)
+{
+#ifdef IG_OS_LINUX
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat info;
+        void* data = MAP_FAILED;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+            data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // The mapping stays valid
+
+        if (data != MAP_FAILED)
+            return std::make_unique<MappedRayReader>(reinterpret_cast<const float*>(data), (size_t)info.st_size);
+    }
+
+    IG_LOG(L_WARNING) << "Could not map '" << path << "' into memory, falling back to buffered reading" << std::endl;
+#endif
+
+    auto stream = std::make_unique<std::ifstream>(path, std::ios::in | std::ios::binary);
+    if (!*stream)
+        return nullptr;
+    return std::make_unique<OwningBinaryRayReader>(std::move(stream));
+}
+
+class TextRadianceWriter : public RadianceWriter {
+public:
+    inline explicit TextRadianceWriter(std::ostream& stream)
+        : mStream(stream)
+    {
+    }
+
+    void write(const float* data, size_t count, float scale) override
+    {
+        // Do not use std::endl, as flushing every line is very costly
+        for (size_t i = 0; i < count; ++i)
+            mStream << data[3 * i + 0] * scale << " " << data[3 * i + 1] * scale << " " << data[3 * i + 2] * scale << '\n';
+        mStream.flush();
+    }
+
+private:
+    std::ostream& mStream;
+};
+
+class BinaryRadianceWriter : public RadianceWriter {
+public:
+    inline explicit BinaryRadianceWriter(std::ostream& stream)
+        : mStream(stream)
+    {
+    }
+
+    void write(const float* data, size_t count, float scale) override
+    {
+        mBuffer.resize(count * 3);
+        for (size_t i = 0; i < count * 3; ++i)
+            mBuffer[i] = data[i] * scale;
+        mStream.write(reinterpret_cast<const char*>(mBuffer.data()), count * BinaryRadianceRecordSize);
+    }
+
+private:
+    std::ostream& mStream;
+    std::vector<float> mBuffer;
+};
+
+std::unique_ptr<RadianceWriter> RadianceWriter::createText(std::ostream& stream)
+{
+    return std::make_unique<TextRadianceWriter>(stream);
+}
+
+std::unique_ptr<RadianceWriter> RadianceWriter::createBinary(std::ostream& stream)
+{
+    return std::make_unique<BinaryRadianceWriter>(stream);
+}
+} // namespace IG
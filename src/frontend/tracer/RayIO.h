@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Runtime.h"
+
+namespace IG {
+// Binary records are packed little endian float32 values without any header:
+//  Input:  [origin.x, origin.y, origin.z, direction.x, direction.y, direction.z, tmin, tmax]
+//  Output: [r, g, b]
+constexpr size_t BinaryRayRecordSize      = 8 * sizeof(float);
+constexpr size_t BinaryRadianceRecordSize = 3 * sizeof(float);
+
+class RayReader {
+public:
+    virtual ~RayReader() = default;
+
+    // Read up to maxCount rays (or all remaining if maxCount is zero) into the given array. Returns number of rays read
+    virtual size_t read(std::vector<Ray>& rays, size_t maxCount) = 0;
+
+    // One ray per line, whitespace separated. Reading stops at the first empty line
+    static std::unique_ptr<RayReader> createText(std::istream& stream, bool interactive);
+    static std::unique_ptr<RayReader> createBinary(std::istream& stream);
+    // Map the whole file into memory. Falls back to buffered reading if not supported by the system
+    static std::unique_ptr<RayReader> createMapped(const std::filesystem::path& path);
+};
+
+class RadianceWriter {
+public:
+    virtual ~RadianceWriter() = default;
+
+    // Write count radiance values given as rgb triplets, each multiplied by the given scale
+    virtual void write(const float* data, size_t count, float scale) = 0;
+
+    static std::unique_ptr<RadianceWriter> createText(std::ostream& stream);
+    static std::unique_ptr<RadianceWriter> createBinary(std::ostream& stream);
+};
+} // namespace IG
@@ -1,9 +1,9 @@
 #include "Logger.h"
+#include "RayIO.h"
 #include "Runtime.h"
 #include "config/Build.h"
 
 #include <fstream>
-#include <sstream>
 
 using namespace IG;
 
@@ -36,7 +36,18 @@ static inline void usage()
         << "           --gpu                    Use autodetected GPU target" << std::endl
         << "   -n      --count    count         Samples per ray. Default is 1" << std::endl
         << "   -i      --input    list.txt      Read list of rays from file instead of the standard input" << std::endl
-        << "   -o      --output   radiance.txt  Write radiance for each ray into file instead of standard output" << std::endl;
+        << "   -o      --output   radiance.txt  Write radiance for each ray into file instead of standard output" << std::endl
+        << "           --input-format  format   Format of the input rays, either 'text' or 'binary' (default: text)" << std::endl
+        << "           --output-format format   Format of the output radiance, either 'text' or 'binary' (default: text)" << std::endl
+        << "           --binary                 Same as --input-format binary --output-format binary" << std::endl
+        << "           --mmap                   Map the binary input file into memory instead of reading it" << std::endl
+        << "           --batch    count         Trace rays in batches of the given size to keep memory bounded (default: all at once)" << std::endl
+        << "           --stats-json file.json   Acquire stats alongside tracing and write them as JSON to the given file" << std::endl
+        << "           --trace-file file.json   Record a timeline of all shader launches in the chrome trace event format" << std::endl
+        << "           --cache-dir dir          Directory for generated data reused across runs, e.g., sky textures (default: data)" << std::endl
+        << "Binary records are packed float32 values:" << std::endl
+        << "    Input:  origin.x origin.y origin.z direction.x direction.y direction.z tmin tmax" << std::endl
+        << "    Output: r g b" << std::endl;
 }
 
 static inline float safe_rcp(float x)
@@ -49,36 +60,25 @@ static inline float safe_rcp(float x)
     }
 }
 
-static std::vector<Ray> read_input(std::istream& is, bool file)
+static inline bool parse_format(const char* str, bool& binary)
 {
-    std::vector<Ray> rays;
-    while (true) {
-        if (!file)
-            std::cout << ">> ";
-
-        std::string line;
-        if (!std::getline(is, line) || line.empty())
-            break;
-
-        std::stringstream stream(line);
-
-        Ray ray;
-        stream >> ray.Origin(0) >> ray.Origin(1) >> ray.Origin(2) >> ray.Direction(0) >> ray.Direction(1) >> ray.Direction(2) >> ray.Range(0) >> ray.Range(1);
-
-        if (ray.Range(1) <= ray.Range(0))
-            ray.Range(1) = std::numeric_limits<float>::max();
-
-        rays.push_back(ray);
-    }
-
-    return rays;
+    if (!strcmp(str, "text"))
+        binary = false;
+    else if (!strcmp(str, "binary"))
+        binary = true;
+    else
+        return false;
+    return true;
 }
 
-static void write_output(std::ostream& is, float* data, size_t count, uint32 spp)
+static inline void write_stats_file(const std::string& path, const std::string& content)
 {
-    for (size_t i = 0; i < count; ++i) {
-        is << data[3 * i + 0] / spp << " " << data[3 * i + 1] / spp << " " << data[3 * i + 2] / spp << std::endl;
+    std::ofstream stream(path);
+    if (!stream) {
+        IG_LOG(L_ERROR) << "Could not open '" << path << "' for writing statistics" << std::endl;
+        return;
     }
+    stream << content;
 }
 
 int main(int argc, char** argv)
@@ -94,6 +94,12 @@ int main(int argc, char** argv)
     std::string out_file;
     RuntimeOptions opts;
     bool quiet = false;
+    std::string stats_json_file;
+    std::string trace_file;
+    bool binary_input  = false;
+    bool binary_output = false;
+    bool use_mmap      = false;
+    size_t batch_size  = 0;
 
     opts.OverrideCamera = "list";
 
@@ -110,6 +116,35 @@ int main(int argc, char** argv)
                 check_arg(argc, argv, i, 1);
                 ++i;
                 ray_file = argv[i];
+            } else if (!strcmp(argv[i], "--input-format")) {
+                check_arg(argc, argv, i, 1);
+                if (!parse_format(argv[++i], binary_input)) {
+                    IG_LOG(L_ERROR) << "Unknown input format '" << argv[i] << "'. Aborting." << std::endl;
+                    return EXIT_FAILURE;
+                }
+            } else if (!strcmp(argv[i], "--output-format")) {
+                check_arg(argc, argv, i, 1);
+                if (!parse_format(argv[++i], binary_output)) {
+                    IG_LOG(L_ERROR) << "Unknown output format '" << argv[i] << "'. Aborting." << std::endl;
+                    return EXIT_FAILURE;
+                }
+            } else if (!strcmp(argv[i], "--binary")) {
+                binary_input  = true;
+                binary_output = true;
+            } else if (!strcmp(argv[i], "--mmap")) {
+                use_mmap = true;
+            } else if (!strcmp(argv[i], "--batch")) {
+                check_arg(argc, argv, i, 1);
+                batch_size = (size_t)strtoull(argv[++i], nullptr, 10);
+            } else if (!strcmp(argv[i], "--stats-json")) {
+                check_arg(argc, argv, i, 1);
+                opts.AcquireStats = true;
+                stats_json_file   = argv[++i];
+            } else if (!strcmp(argv[i], "--trace-file")) {
+                check_arg(argc, argv, i, 1);
+                opts.AcquireStats   = true;
+                opts.RecordTimeline = true;
+                trace_file          = argv[++i];
             } else if (!strcmp(argv[i], "-q") || !strcmp(argv[i], "--quiet")) {
                 quiet = true;
                 IG_LOGGER.setQuiet(true);
@@ -156,6 +191,9 @@ int main(int argc, char** argv)
             } else if (!strcmp(argv[i], "--gpu")) {
                 opts.RecommendCPU = false;
                 opts.RecommendGPU = true;
+            } else if (!strcmp(argv[i], "--cache-dir")) {
+                check_arg(argc, argv, i, 1);
+                opts.CacheDir = argv[++i];
             } else {
                 IG_LOG(L_ERROR) << "Unknown option '" << argv[i] << "'" << std::endl;
                 return EXIT_FAILURE;
@@ -173,14 +211,50 @@ int main(int argc, char** argv)
     if (!quiet)
         std::cout << Build::getCopyrightString() << std::endl;
 
-    std::vector<Ray> rays;
-    if (ray_file.empty()) {
-        rays = read_input(std::cin, false);
+    if (use_mmap && (!binary_input || ray_file.empty())) {
+        IG_LOG(L_ERROR) << "Memory mapping is only available for binary input files" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Setup input
+    std::unique_ptr<std::ifstream> in_stream;
+    std::unique_ptr<RayReader> reader;
+    if (use_mmap) {
+        reader = RayReader::createMapped(ray_file);
     } else {
-        std::ifstream stream(ray_file);
-        rays = read_input(stream, true);
+        if (!ray_file.empty()) {
+            in_stream = std::make_unique<std::ifstream>(ray_file, binary_input ? std::ios::in | std::ios::binary : std::ios::in);
+            if (!*in_stream)
+                in_stream.reset();
+        } else if (binary_input) {
+            std::ios::sync_with_stdio(false);
+        }
+
+        std::istream& is = ray_file.empty() ? std::cin : *in_stream;
+        if (in_stream || ray_file.empty())
+            reader = binary_input ? RayReader::createBinary(is) : RayReader::createText(is, ray_file.empty() && !binary_input);
     }
 
+    if (!reader) {
+        IG_LOG(L_ERROR) << "Could not open '" << ray_file << "' for reading rays" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Setup output
+    std::unique_ptr<std::ofstream> out_stream;
+    if (!out_file.empty()) {
+        out_stream = std::make_unique<std::ofstream>(out_file, binary_output ? std::ios::out | std::ios::binary : std::ios::out);
+        if (!*out_stream) {
+            IG_LOG(L_ERROR) << "Could not open '" << out_file << "' for writing radiance" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    std::ostream& os                       = out_file.empty() ? std::cout : *out_stream;
+    std::unique_ptr<RadianceWriter> writer = binary_output ? RadianceWriter::createBinary(os) : RadianceWriter::createText(os);
+
+    std::vector<Ray> rays;
+    reader->read(rays, batch_size);
+
     if (rays.empty()) {
         IG_LOG(L_ERROR) << "No rays given" << std::endl;
         return EXIT_FAILURE;
@@ -194,28 +268,28 @@ int main(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
+    // The framebuffer grows automatically if a following batch is larger
     runtime->setup(rays.size(), 1);
 
     const size_t SPP = runtime->samplesPerIteration();
-    sample_count     = static_cast<size_t>(std::ceil(sample_count / SPP));
+    sample_count     = static_cast<uint32>(std::max<size_t>(1, (sample_count + SPP - 1) / SPP));
 
-    std::vector<float> accum_data;
-    std::vector<float> iter_data;
-    for (uint32 iter = 0; iter < sample_count; ++iter) {
-        runtime->trace(rays, iter_data);
+    std::vector<float> radiance;
+    size_t total_rays = 0;
+    do {
+        runtime->trace(rays, radiance, sample_count);
+        writer->write(radiance.data(), rays.size(), 1.0f);
+        total_rays += rays.size();
+    } while (batch_size != 0 && reader->read(rays, batch_size) != 0);
 
-        if (accum_data.size() != iter_data.size())
-            accum_data.resize(iter_data.size(), 0.0f);
-        for (size_t i = 0; i < iter_data.size(); ++i)
-            accum_data[i] += iter_data[i];
-    }
+    os.flush();
+    IG_LOG(L_DEBUG) << "Traced " << total_rays << " rays" << std::endl;
 
-    // Extract data
-    if (out_file.empty()) {
-        write_output(std::cout, accum_data.data(), rays.size(), sample_count);
-    } else {
-        std::ofstream stream(out_file);
-        write_output(stream, accum_data.data(), rays.size(), sample_count);
+    if (const Statistics* stats = runtime->getStatistics()) {
+        if (!stats_json_file.empty())
+            write_stats_file(stats_json_file, stats->dumpAsJSON(runtime->currentIterationCount()));
+        if (!trace_file.empty())
+            write_stats_file(trace_file, stats->dumpAsChromeTrace());
     }
 
     return EXIT_SUCCESS;
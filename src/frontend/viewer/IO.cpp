@@ -72,20 +72,23 @@ bool saveImageRGBA(const std::filesystem::path& path, const float* rgb, size_t w
 
 bool saveImageOutput(const std::filesystem::path& path, const Runtime& runtime)
 {
-    size_t width  = runtime.loadedRenderSettings().FilmWidth;
-    size_t height = runtime.loadedRenderSettings().FilmHeight;
-    float scale   = 1.0f / runtime.currentIterationCount();
-    if (runtime.currentIterationCount() == 0)
+    size_t width  = runtime.framebufferWidth();
+    size_t height = runtime.framebufferHeight();
+    float scale   = 1.0f / runtime.currentFilmIterationCount();
+    if (runtime.currentFilmIterationCount() == 0)
         scale = 0;
 
-    size_t aov_count = runtime.aovs().size() + 1;
+    // The denoised framebuffer is stored as an additional layer
+    const float* denoised   = runtime.getDenoisedFramebuffer();
+    const size_t film_count = runtime.aovs().size() + 1;
+    const size_t aov_count  = film_count + (denoised ? 1 : 0);
 
     const RangeS imageRange(0, width * height);
     std::vector<float> images(width * height * 3 * aov_count);
 
     // Copy data
     for (size_t aov = 0; aov < aov_count; ++aov) {
-        const float* src = runtime.getFramebuffer((int)aov);
+        const float* src = aov < film_count ? runtime.getFramebuffer((int)aov) : denoised;
         float* dst_r     = &images[width * height * (3 * aov + 0)];
         float* dst_g     = &images[width * height * (3 * aov + 1)];
         float* dst_b     = &images[width * height * (3 * aov + 2)];
@@ -122,7 +125,7 @@ bool saveImageOutput(const std::filesystem::path& path, const Runtime& runtime)
             image_names[3 * aov + 1] = "Default.G";
             image_names[3 * aov + 2] = "Default.R";
         } else {
-            std::string name         = runtime.aovs()[aov - 1];
+            std::string name         = aov < film_count ? runtime.aovs()[aov - 1] : "Denoised";
             image_names[3 * aov + 0] = name + ".B";
             image_names[3 * aov + 1] = name + ".G";
             image_names[3 * aov + 2] = name + ".R";
@@ -13,6 +13,7 @@
 
 #include "Timer.h"
 
+#include <fstream>
 #include <optional>
 
 using namespace IG;
@@ -59,15 +60,26 @@ static inline void usage()
         << "           --range     tmin tmax  Sets near and far clip range in world units" << std::endl
         << "           --camera    cam_type   Override camera type" << std::endl
         << "           --technique tech_type  Override technique/integrator type" << std::endl
+        << "           --sampler   type       Override pixel sampler type (uniform, mjitt or sobol)" << std::endl
         << "   -t      --target    target     Sets the target platform (default: autodetect CPU)" << std::endl
         << "   -d      --device    device     Sets the device to use on the selected platform (default: 0)" << std::endl
         << "           --cpu                  Use autodetected CPU target" << std::endl
         << "           --gpu                  Use autodetected GPU target" << std::endl
         << "           --debug                Same as --technique debug" << std::endl
         << "           --spp       spp        Enables benchmarking mode and sets the number of iterations based on the given spp" << std::endl
+        << "           --time      seconds    Enables benchmarking mode and stops rendering after the given wall-clock time" << std::endl
+        << "           --checkpoint seconds   Periodically writes the current film and all AOVs to the checkpoint file" << std::endl
+        << "           --checkpoint-file file Sets the file used for checkpoints (default: output file)" << std::endl
+        << "           --resume    film.igf   Continues rendering from the film state written alongside a checkpoint" << std::endl
+        << "           --seed      offset     Sets the offset added to the iteration number used to seed the random number generators" << std::endl
+        << "           --adaptive  error      Skips image tiles whose pixels are below the given relative error (CPU only)" << std::endl
+        << "           --denoise              Enables the albedo, normal and depth aovs and adds a denoised image to the output" << std::endl
         << "           --stats                Acquire useful stats alongside rendering. Will be dumped at the end of the rendering session" << std::endl
         << "           --full-stats           Acquire all stats alongside rendering. Will be dumped at the end of the rendering session" << std::endl
+        << "           --stats-json file.json Acquire stats alongside rendering and write them as JSON to the given file" << std::endl
+        << "           --trace-file file.json Record a timeline of all shader launches in the chrome trace event format" << std::endl
         << "   -o      --output    image.exr  Writes the output image to a file" << std::endl
+        << "           --cache-dir dir        Directory for generated data reused across runs, e.g., sky textures (default: data)" << std::endl
         << "           --dump-shader          Dump produced shaders to files in the current working directory" << std::endl
         << "           --dump-shader-full     Dump produced shaders with standard library to files in the current working directory" << std::endl
         << "Available targets:" << std::endl
@@ -76,7 +88,42 @@ static inline void usage()
         << "Available cameras:" << std::endl
         << "    perspective, orthogonal, fishlens" << std::endl
         << "Available techniques:" << std::endl
-        << "    path, debug, ao" << std::endl;
+        << "    path, guided, lighttracer, debug, ao" << std::endl;
+}
+
+static inline std::filesystem::path film_state_path(const std::filesystem::path& path)
+{
+    return std::filesystem::path(path).replace_extension(".igf");
+}
+
+static inline bool write_checkpoint(const std::filesystem::path& path, Runtime& runtime)
+{
+    if (runtime.hasDenoiser())
+        runtime.denoise();
+
+    // Write into temporary files first, such that a killed job never leaves a corrupted checkpoint behind
+    const std::filesystem::path tmp_path = path.parent_path() / (path.stem().generic_string() + ".tmp" + path.extension().generic_string());
+    const std::filesystem::path tmp_film = film_state_path(path).replace_extension(".tmp.igf");
+    if (!saveImageOutput(tmp_path, runtime) || !runtime.saveFilm(tmp_film))
+        return false;
+
+    // The film state is used for resuming, the image is only for inspection
+    std::error_code ec;
+    std::filesystem::rename(tmp_film, film_state_path(path), ec);
+    if (!ec)
+        std::filesystem::rename(tmp_path, path, ec);
+    return !ec;
+}
+
+static inline void write_stats_file(const std::string& path, const std::string& content)
+{
+    std::ofstream stream(path);
+    if (!stream) {
+        IG_LOG(L_ERROR) << "Could not open '" << path << "' for writing statistics" << std::endl;
+        return;
+    }
+    stream << content;
+    IG_LOG(L_INFO) << "Statistics written to '" << path << "'" << std::endl;
 }
 
 struct SectionTimer {
@@ -96,7 +143,12 @@ int main(int argc, char** argv)
 
     std::string in_file;
     std::string out_file;
-    size_t desired_spp = 0;
+    size_t desired_spp           = 0;
+    size_t desired_time_s        = 0;
+    size_t checkpoint_interval_s = 0;
+    std::string checkpoint_file;
+    std::string resume_file;
+    std::optional<uint32> seed_offset;
     std::optional<int> a_film_width;
     std::optional<int> a_film_height;
     std::optional<Vector3f> eye;
@@ -109,6 +161,8 @@ int main(int argc, char** argv)
 
     RuntimeOptions opts;
     bool all_stats = false;
+    std::string stats_json_file;
+    std::string trace_file;
 
     for (int i = 1; i < argc; ++i) {
         if (argv[i][0] == '-') {
@@ -176,6 +230,29 @@ int main(int argc, char** argv)
             } else if (!strcmp(argv[i], "--spp")) {
                 check_arg(argc, argv, i, 1);
                 desired_spp = (size_t)strtoul(argv[++i], nullptr, 10);
+            } else if (!strcmp(argv[i], "--time")) {
+                check_arg(argc, argv, i, 1);
+                desired_time_s = (size_t)strtoul(argv[++i], nullptr, 10);
+            } else if (!strcmp(argv[i], "--checkpoint")) {
+                check_arg(argc, argv, i, 1);
+                checkpoint_interval_s = (size_t)strtoul(argv[++i], nullptr, 10);
+            } else if (!strcmp(argv[i], "--checkpoint-file")) {
+                check_arg(argc, argv, i, 1);
+                checkpoint_file = argv[++i];
+            } else if (!strcmp(argv[i], "--resume")) {
+                check_arg(argc, argv, i, 1);
+                resume_file = argv[++i];
+            } else if (!strcmp(argv[i], "--seed")) {
+                check_arg(argc, argv, i, 1);
+                seed_offset = (uint32)strtoul(argv[++i], nullptr, 10);
+            } else if (!strcmp(argv[i], "--adaptive")) {
+                check_arg(argc, argv, i, 1);
+                opts.AdaptiveError = strtof(argv[++i], nullptr);
+            } else if (!strcmp(argv[i], "--denoise")) {
+                opts.Denoise = true;
+            } else if (!strcmp(argv[i], "--cache-dir")) {
+                check_arg(argc, argv, i, 1);
+                opts.CacheDir = argv[++i];
             } else if (!strcmp(argv[i], "--spi")) {
                 check_arg(argc, argv, i, 1);
                 opts.SPI = (size_t)strtoul(argv[++i], nullptr, 10);
@@ -187,6 +264,10 @@ int main(int argc, char** argv)
                 check_arg(argc, argv, i, 1);
                 ++i;
                 opts.OverrideCamera = argv[i];
+            } else if (!strcmp(argv[i], "--sampler")) {
+                check_arg(argc, argv, i, 1);
+                ++i;
+                opts.OverridePixelSampler = argv[i];
             } else if (!strcmp(argv[i], "--technique")) {
                 check_arg(argc, argv, i, 1);
                 ++i;
@@ -210,6 +291,15 @@ int main(int argc, char** argv)
             } else if (!strcmp(argv[i], "--full-stats")) {
                 opts.AcquireStats = true;
                 all_stats         = true;
+            } else if (!strcmp(argv[i], "--stats-json")) {
+                check_arg(argc, argv, i, 1);
+                opts.AcquireStats = true;
+                stats_json_file   = argv[++i];
+            } else if (!strcmp(argv[i], "--trace-file")) {
+                check_arg(argc, argv, i, 1);
+                opts.AcquireStats   = true;
+                opts.RecordTimeline = true;
+                trace_file          = argv[++i];
             } else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
                 usage();
                 return EXIT_SUCCESS;
@@ -239,8 +329,8 @@ int main(int argc, char** argv)
     }
 
 #ifndef WITH_UI
-    if (desired_spp <= 0) {
-        IG_LOG(L_ERROR) << "No valid spp count given" << std::endl;
+    if (desired_spp <= 0 && desired_time_s <= 0) {
+        IG_LOG(L_ERROR) << "No valid spp count or time budget given" << std::endl;
         return EXIT_FAILURE;
     }
     if (out_file.empty()) {
@@ -249,6 +339,13 @@ int main(int argc, char** argv)
     }
 #endif
 
+    if (checkpoint_file.empty())
+        checkpoint_file = out_file;
+    if (checkpoint_interval_s > 0 && checkpoint_file.empty()) {
+        IG_LOG(L_ERROR) << "No checkpoint file given" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     SectionTimer timer_all;
     SectionTimer timer_loading;
     timer_all.start();
@@ -272,13 +369,25 @@ int main(int argc, char** argv)
                   clip(0), clip(1));
     runtime->setup(film_width, film_height);
 
+    if (!resume_file.empty()) {
+        if (!runtime->loadFilm(resume_file)) {
+            IG_LOG(L_ERROR) << "Could not resume from '" << resume_file << "'" << std::endl;
+            return EXIT_FAILURE;
+        }
+        IG_LOG(L_INFO) << "Resuming from iteration " << runtime->currentFilmIterationCount() << std::endl;
+    }
+    if (seed_offset.has_value())
+        runtime->setSeedOffset(seed_offset.value());
+
     const size_t SPI          = runtime->samplesPerIteration();
     const size_t desired_iter = static_cast<size_t>(std::ceil(desired_spp / SPI));
+    const bool benchmarking   = desired_iter != 0 || desired_time_s != 0;
 
 #ifdef WITH_UI
     IG_UNUSED(prettyConsole);
 
     std::unique_ptr<UI> ui;
+    const int denoised_aov = runtime->hasDenoiser() ? (int)runtime->aovs().size() + 1 : -1; // Shown after all other aovs
     try {
         size_t aov_count = runtime->aovs().size() + 1;
         std::vector<const float*> aovs(aov_count);
@@ -291,6 +400,10 @@ int main(int argc, char** argv)
             else
                 aov_names[i] = runtime->aovs()[i - 1];
         }
+        if (denoised_aov >= 0) {
+            aovs.push_back(runtime->getDenoisedFramebuffer());
+            aov_names.push_back("Denoised");
+        }
         ui = std::make_unique<UI>(film_width, film_height, aovs, aov_names, runtime->isDebug());
     } catch (...) {
         return EXIT_FAILURE;
@@ -308,15 +421,26 @@ int main(int argc, char** argv)
     bool done       = false;
     uint64_t timing = 0;
     uint32_t frames = 0;
-    uint32_t iter   = 0;
+    uint32_t iter   = runtime->currentFilmIterationCount();
     std::vector<double> samples_sec;
 
+    // Iterations rendered in this session, excluding resumed ones
+    uint64_t rendered_iter = 0;
+
+    if (desired_iter != 0 && iter >= desired_iter) {
+        IG_LOG(L_INFO) << "Resumed film already contains the desired " << desired_iter << " iterations" << std::endl;
+        done = true;
+    }
+
 #ifdef WITH_UI
     SectionTimer timer_input;
     SectionTimer timer_ui;
+    uint32_t last_denoised_iter = 0;
 #endif
 
     SectionTimer timer_render;
+    SectionTimer timer_checkpoint;
+    size_t last_checkpoint_ms = 0;
     while (!done) {
 #ifdef WITH_UI
         bool prevRun = running;
@@ -344,11 +468,22 @@ int main(int argc, char** argv)
             timer_render.stop();
 
             iter++;
+            rendered_iter++;
             auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - ticks).count();
 
-            if (desired_iter != 0) {
-                samples_sec.emplace_back(1000.0 * double(SPI * film_width * film_height) / double(elapsed_ms));
-                if (samples_sec.size() == desired_iter)
+            if (checkpoint_interval_s > 0 && timer_render.duration_ms - last_checkpoint_ms >= checkpoint_interval_s * 1000) {
+                timer_checkpoint.start();
+                if (!write_checkpoint(checkpoint_file, *runtime))
+                    IG_LOG(L_ERROR) << "Failed to write checkpoint '" << checkpoint_file << "'" << std::endl;
+                timer_checkpoint.stop();
+                last_checkpoint_ms = timer_render.duration_ms;
+            }
+
+            if (benchmarking) {
+                samples_sec.emplace_back(1000.0 * double(SPI * film_width * film_height) / double(std::max<int64_t>(1, elapsed_ms)));
+                if (desired_iter != 0 && iter >= desired_iter)
+                    break;
+                if (desired_time_s != 0 && timer_render.duration_ms >= desired_time_s * 1000)
                     break;
             }
 
@@ -386,6 +521,10 @@ int main(int argc, char** argv)
 
 #ifdef WITH_UI
         timer_ui.start();
+        if (ui->currentAOV() == denoised_aov && last_denoised_iter != iter) {
+            runtime->denoise();
+            last_denoised_iter = iter;
+        }
         ui->update(iter, SPI);
         timer_ui.stop();
 #endif
@@ -400,11 +539,15 @@ int main(int argc, char** argv)
     SectionTimer timer_saving;
     timer_saving.start();
     if (!out_file.empty()) {
+        if (runtime->hasDenoiser())
+            runtime->denoise();
         if (!saveImageOutput(out_file, *runtime))
             IG_LOG(L_ERROR) << "Failed to save EXR file '" << out_file << "'" << std::endl;
         else
             IG_LOG(L_INFO) << "Result saved to '" << out_file << "'" << std::endl;
     }
+    if (checkpoint_interval_s > 0 && !runtime->saveFilm(film_state_path(checkpoint_file)))
+        IG_LOG(L_ERROR) << "Failed to save film state '" << film_state_path(checkpoint_file) << "'" << std::endl;
     timer_saving.stop();
 
     timer_all.stop();
@@ -423,18 +566,33 @@ int main(int argc, char** argv)
             << "    UI>      " << timer_ui.duration_ms << "ms" << std::endl
 #endif
             << "    Render>  " << timer_render.duration_ms << "ms" << std::endl
+            << "    Checkpt> " << timer_checkpoint.duration_ms << "ms" << std::endl
             << "    Saving>  " << timer_saving.duration_ms << "ms" << std::endl;
+
+        if (!stats_json_file.empty())
+            write_stats_file(stats_json_file, stats->dumpAsJSON(iter));
+        if (!trace_file.empty())
+            write_stats_file(trace_file, stats->dumpAsChromeTrace());
     }
 
+    // Camera rays are always known, all traced rays are only counted by the CPU trace loop
+    const double render_sec  = std::max<size_t>(1, timer_render.duration_ms) / 1000.0;
+    const double camera_rays = double(rendered_iter) * SPI * film_width * film_height;
+    const uint64 total_rays  = stats ? stats->quantity(Quantity::PrimaryRays) + stats->quantity(Quantity::SecondaryRays) : 0;
+
     runtime.reset();
 
-    if (desired_iter != 0) {
+    if (benchmarking && !samples_sec.empty()) {
         auto inv = 1.0e-6;
         std::sort(samples_sec.begin(), samples_sec.end());
         IG_LOG(L_INFO) << "# " << samples_sec.front() * inv
                        << "/" << samples_sec[samples_sec.size() / 2] * inv
                        << "/" << samples_sec.back() * inv
                        << " (min/med/max Msamples/s)" << std::endl;
+
+        IG_LOG(L_INFO) << "# " << camera_rays / render_sec * inv << " Mrays/s (camera)" << std::endl;
+        if (total_rays > 0)
+            IG_LOG(L_INFO) << "# " << total_rays / render_sec * inv << " Mrays/s (total)" << std::endl;
     }
 
     return EXIT_SUCCESS;
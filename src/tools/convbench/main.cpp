@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "Camera.h"
+#include "Image.h"
+#include "Logger.h"
+#include "Runtime.h"
+#include "config/Build.h"
+
+using namespace IG;
+
+// Offset of the relative error, same as used by scenes/evaluation/MakeFigure.py
+constexpr double RelMSEEpsilon = 1e-3;
+
+struct BenchmarkOptions {
+    std::vector<Target> Targets;
+    size_t MaxSPP   = 256;
+    double MaxTime  = 0; // Seconds per scene and target, zero for no limit
+    size_t RefSPP   = 0; // If not zero, references are generated instead
+    bool Stats      = false;
+    std::filesystem::path ReferenceDir;
+};
+
+struct ErrorResult {
+    double RMSE;
+    double RelMSE;
+};
+
+static inline void check_arg(int argc, char** argv, int arg, int n)
+{
+    if (arg + n >= argc)
+        IG_LOG(L_ERROR) << "Option '" << argv[arg] << "' expects " << n << " arguments, got " << (argc - arg) << std::endl;
+}
+
+static inline void usage()
+{
+    std::cout
+        << "convbench - Ignis Convergence Benchmark" << std::endl
+        << Build::getCopyrightString() << std::endl
+        << "Usage: convbench [options] scene.json..." << std::endl
+        << "Renders every scene with a power of two ladder of samples per pixel and compares each step against a reference image." << std::endl
+        << "Available options:" << std::endl
+        << "   -h      --help                   Shows this message" << std::endl
+        << "   -q      --quiet                  Do not print messages into console" << std::endl
+        << "   -t      --target    target       Adds a target platform to benchmark. Can be given multiple times (default: autodetect CPU)" << std::endl
+        << "           --spp       spp          Maximum samples per pixel of the ladder (default: 256)" << std::endl
+        << "           --time      seconds      Stops the ladder of a scene after the given rendering time" << std::endl
+        << "           --references dir         Directory containing the references named SCENE.exr (default: SCENE_reference.exr next to the scene)" << std::endl
+        << "           --generate  spp          Render and store the references with the given samples per pixel instead of benchmarking" << std::endl
+        << "           --stats                  Acquire stats to report the total number of traced rays. Slows down rendering" << std::endl
+        << "   -o      --output    result.csv   Write results into the given file instead of the standard output. The log is disabled when writing to the standard output" << std::endl
+        << "           --append                 Append results to the output file instead of replacing it" << std::endl
+        << "Available targets:" << std::endl
+        << "    generic, sse42, avx, avx2, avx512, asimd, nvvm, amdgpu" << std::endl;
+}
+
+static inline bool parse_target(const char* str, Target& target)
+{
+    if (!strcmp(str, "generic"))
+        target = Target::GENERIC;
+    else if (!strcmp(str, "sse42"))
+        target = Target::SSE42;
+    else if (!strcmp(str, "avx"))
+        target = Target::AVX;
+    else if (!strcmp(str, "avx2"))
+        target = Target::AVX2;
+    else if (!strcmp(str, "avx512"))
+        target = Target::AVX512;
+    else if (!strcmp(str, "asimd"))
+        target = Target::ASIMD;
+    else if (!strcmp(str, "nvvm"))
+        target = Target::NVVM;
+    else if (!strcmp(str, "amdgpu"))
+        target = Target::AMDGPU;
+    else
+        return false;
+    return true;
+}
+
+static inline std::filesystem::path reference_path(const std::filesystem::path& scene, const BenchmarkOptions& opts)
+{
+    if (opts.ReferenceDir.empty())
+        return scene.parent_path() / (scene.stem().generic_u8string() + "_reference.exr");
+    else
+        return opts.ReferenceDir / (scene.stem().generic_u8string() + ".exr");
+}
+
+static std::unique_ptr<Runtime> create_runtime(const std::filesystem::path& scene, Target target, bool stats)
+{
+    RuntimeOptions opts;
+    opts.DesiredTarget = target;
+    opts.AcquireStats  = stats;
+
+    std::unique_ptr<Runtime> runtime;
+    try {
+        runtime = std::make_unique<Runtime>(scene, opts);
+    } catch (const std::exception& e) {
+        IG_LOG(L_ERROR) << e.what() << std::endl;
+        return nullptr;
+    }
+
+    const auto def = runtime->loadedRenderSettings();
+    runtime->setup(def.FilmWidth, def.FilmHeight);
+    return runtime;
+}
+
+static inline Camera default_camera(const Runtime& runtime)
+{
+    const auto def = runtime.loadedRenderSettings();
+    return Camera(def.CameraEye, def.CameraDir, def.CameraUp, def.FOV, (float)def.FilmWidth / (float)def.FilmHeight, def.TMin, def.TMax);
+}
+
+static inline ErrorResult compute_error(const float* film, float scale, const ImageRgba32& reference)
+{
+    double se    = 0;
+    double relse = 0;
+
+    const size_t count = reference.width * reference.height;
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t c = 0; c < 3; ++c) {
+            const double ref  = reference.pixels[4 * i + c];
+            const double diff = film[3 * i + c] * scale - ref;
+            se += diff * diff;
+            relse += diff * diff / (ref * ref + RelMSEEpsilon);
+        }
+    }
+
+    return ErrorResult{ std::sqrt(se / (3 * count)), relse / (3 * count) };
+}
+
+static bool generate_reference(const std::filesystem::path& scene, Target target, const BenchmarkOptions& opts)
+{
+    auto runtime = create_runtime(scene, target, false);
+    if (!runtime)
+        return false;
+    const Camera camera = default_camera(*runtime);
+
+    // Independent from the benchmarked renderings, which start at seed offset zero. Otherwise the error would be biased low
+    runtime->setSeedOffset(0x80000000);
+
+    const size_t iterations = std::max<size_t>(1, (opts.RefSPP + runtime->samplesPerIteration() - 1) / runtime->samplesPerIteration());
+    for (size_t i = 0; i < iterations; ++i)
+        runtime->step(camera);
+
+    const size_t width  = runtime->framebufferWidth();
+    const size_t height = runtime->framebufferHeight();
+    const float* film   = runtime->getFramebuffer(0);
+    const float scale   = 1.0f / iterations;
+
+    std::vector<float> rgba(width * height * 4);
+    for (size_t i = 0; i < width * height; ++i) {
+        for (size_t c = 0; c < 3; ++c)
+            rgba[4 * i + c] = film[3 * i + c] * scale;
+        rgba[4 * i + 3] = 1;
+    }
+
+    const auto path = reference_path(scene, opts);
+    if (!ImageRgba32::save(path, rgba.data(), width, height)) {
+        IG_LOG(L_ERROR) << "Could not save reference " << path << std::endl;
+        return false;
+    }
+
+    IG_LOG(L_INFO) << "Stored reference " << path << " with " << iterations * runtime->samplesPerIteration() << " spp" << std::endl;
+    return true;
+}
+
+static bool benchmark(const std::filesystem::path& scene, Target target, const BenchmarkOptions& opts, std::ostream& csv)
+{
+    ImageRgba32 reference;
+    try {
+        reference = ImageRgba32::load(reference_path(scene, opts));
+    } catch (const ImageLoadException& e) {
+        IG_LOG(L_ERROR) << e.what() << std::endl;
+        return false;
+    }
+
+    auto runtime = create_runtime(scene, target, opts.Stats);
+    if (!runtime)
+        return false;
+    const Camera camera = default_camera(*runtime);
+
+    const size_t width  = runtime->framebufferWidth();
+    const size_t height = runtime->framebufferHeight();
+    if (reference.width != width || reference.height != height) {
+        IG_LOG(L_ERROR) << "Reference of " << scene << " has size " << reference.width << "x" << reference.height
+                        << " but the film has size " << width << "x" << height << std::endl;
+        return false;
+    }
+
+    const std::string version    = Build::getVersionString();
+    const std::string sceneName  = scene.stem().generic_u8string();
+    const std::string targetName = targetToString(runtime->target());
+    const size_t spi             = runtime->samplesPerIteration();
+
+    // Only the rendering itself (including the final transfer of the film) is measured, not the error computation
+    double seconds   = 0;
+    size_t iteration = 0;
+    size_t nextSPP   = 1;
+    while (iteration * spi < opts.MaxSPP && (opts.MaxTime <= 0 || seconds < opts.MaxTime)) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        runtime->step(camera);
+        ++iteration;
+
+        const size_t spp      = iteration * spi;
+        const bool checkpoint = spp >= nextSPP || spp >= opts.MaxSPP;
+        const float* film     = checkpoint ? runtime->getFramebuffer(0) : nullptr;
+        seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        if (!checkpoint)
+            continue;
+
+        while (nextSPP <= spp)
+            nextSPP *= 2;
+
+        const ErrorResult error  = compute_error(film, 1.0f / iteration, reference);
+        const double cameraRays  = double(spp) * width * height;
+        const Statistics* stats  = runtime->getStatistics();
+        const uint64 totalRays   = stats ? stats->quantity(Quantity::PrimaryRays) + stats->quantity(Quantity::SecondaryRays) : 0;
+        const double safeSeconds = std::max(seconds, 1e-6);
+
+        csv << version << "," << targetName << "," << sceneName << "," << spp << "," << seconds << ","
+            << error.RMSE << "," << error.RelMSE << "," << cameraRays / safeSeconds * 1e-6 << ",";
+        if (totalRays > 0)
+            csv << totalRays / safeSeconds * 1e-6;
+        csv << std::endl;
+
+        IG_LOG(L_INFO) << sceneName << " [" << targetName << "] " << spp << " spp: " << seconds << "s, RMSE " << error.RMSE << ", relMSE " << error.RelMSE << std::endl;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc <= 1) {
+        usage();
+        return EXIT_SUCCESS;
+    }
+
+    BenchmarkOptions opts;
+    std::vector<std::filesystem::path> scenes;
+    std::filesystem::path outFile;
+    bool append = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] == '-') {
+            if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+                usage();
+                return EXIT_SUCCESS;
+            } else if (!strcmp(argv[i], "-q") || !strcmp(argv[i], "--quiet")) {
+                IG_LOGGER.setQuiet(true);
+            } else if (!strcmp(argv[i], "-t") || !strcmp(argv[i], "--target")) {
+                check_arg(argc, argv, i, 1);
+                Target target;
+                if (!parse_target(argv[++i], target)) {
+                    IG_LOG(L_ERROR) << "Unknown target '" << argv[i] << "'. Aborting." << std::endl;
+                    return EXIT_FAILURE;
+                }
+                opts.Targets.push_back(target);
+            } else if (!strcmp(argv[i], "--spp")) {
+                check_arg(argc, argv, i, 1);
+                opts.MaxSPP = std::max<size_t>(1, strtoul(argv[++i], nullptr, 10));
+            } else if (!strcmp(argv[i], "--time")) {
+                check_arg(argc, argv, i, 1);
+                opts.MaxTime = strtod(argv[++i], nullptr);
+            } else if (!strcmp(argv[i], "--references")) {
+                check_arg(argc, argv, i, 1);
+                opts.ReferenceDir = argv[++i];
+            } else if (!strcmp(argv[i], "--generate")) {
+                check_arg(argc, argv, i, 1);
+                opts.RefSPP = std::max<size_t>(1, strtoul(argv[++i], nullptr, 10));
+            } else if (!strcmp(argv[i], "--stats")) {
+                opts.Stats = true;
+            } else if (!strcmp(argv[i], "-o") || !strcmp(argv[i], "--output")) {
+                check_arg(argc, argv, i, 1);
+                outFile = argv[++i];
+            } else if (!strcmp(argv[i], "--append")) {
+                append = true;
+            } else {
+                IG_LOG(L_ERROR) << "Unknown option '" << argv[i] << "'" << std::endl;
+                usage();
+                return EXIT_FAILURE;
+            }
+        } else {
+            scenes.emplace_back(argv[i]);
+        }
+    }
+
+    if (scenes.empty()) {
+        IG_LOG(L_ERROR) << "No scene given" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (opts.Targets.empty())
+        opts.Targets.push_back(Target::INVALID); // Autodetect
+
+    if (opts.RefSPP > 0) {
+        // References are only rendered with the first target
+        bool ok = true;
+        for (const auto& scene : scenes)
+            ok = generate_reference(scene, opts.Targets.front(), opts) && ok;
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    std::ofstream file;
+    bool writeHeader = true;
+    if (!outFile.empty()) {
+        writeHeader = !append || !std::filesystem::exists(outFile) || std::filesystem::file_size(outFile) == 0;
+        file.open(outFile, append ? std::ios::app : std::ios::trunc);
+        if (!file) {
+            IG_LOG(L_ERROR) << "Could not open " << outFile << " for writing" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // The log shares the standard output, keep the table parsable
+    if (outFile.empty())
+        IG_LOGGER.setQuiet(true);
+
+    std::ostream& csv = outFile.empty() ? std::cout : file;
+    if (writeHeader)
+        csv << "version,target,scene,spp,seconds,rmse,relmse,mrays_camera,mrays_total" << std::endl;
+
+    bool ok = true;
+    for (const auto& target : opts.Targets) {
+        for (const auto& scene : scenes)
+            ok = benchmark(scene, target, opts, csv) && ok;
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
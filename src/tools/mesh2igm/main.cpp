@@ -0,0 +1,83 @@
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include "Logger.h"
+#include "mesh/IgMeshFile.h"
+#include "mesh/MtsSerializedFile.h"
+#include "mesh/ObjFile.h"
+#include "mesh/PlyFile.h"
+
+using namespace IG;
+
+static inline void usage()
+{
+    std::cout << "Expected mesh2igm [--bvh] [--shape-index INDEX] INPUT (OUTPUT)" << std::endl
+              << "  INPUT can be a .obj, .ply or .serialized file" << std::endl
+              << "  --bvh                Store prebuilt bvhs for all target variants" << std::endl
+              << "  --shape-index INDEX  Shape to extract from a Mitsuba serialized file" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::string input;
+    std::string output;
+    bool with_bvh      = false;
+    size_t shape_index = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--bvh")) {
+            with_bvh = true;
+        } else if (!strcmp(argv[i], "--shape-index") && i + 1 < argc) {
+            shape_index = strtoul(argv[++i], nullptr, 10);
+        } else if (input.empty()) {
+            input = argv[i];
+        } else if (output.empty()) {
+            output = argv[i];
+        } else {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (input.empty()) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    if (output.empty())
+        output = std::filesystem::path(input).replace_extension(".igm").generic_string();
+
+    try {
+        // Input
+        const std::string ext = std::filesystem::path(input).extension().generic_string();
+
+        TriMesh mesh;
+        if (ext == ".obj") {
+            mesh = obj::load(input);
+        } else if (ext == ".ply") {
+            mesh = ply::load(input);
+        } else if (ext == ".serialized") {
+            mesh = mts::load(input, shape_index);
+        } else {
+            IG_LOG(L_ERROR) << "Unknown input format '" << ext << "'" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (mesh.vertices.empty())
+            return EXIT_FAILURE;
+
+        // Output
+        std::vector<uint32> variants;
+        if (with_bvh)
+            variants = { igm::makeBvhVariant(2, 1), igm::makeBvhVariant(4, 4), igm::makeBvhVariant(8, 4) };
+
+        if (!igm::save(output, mesh, variants))
+            return EXIT_FAILURE;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+#include "Logger.h"
+#include "mesh/ObjFile.h"
+
+using namespace IG;
+
+using LoadFunction = TriMesh (*)(const std::filesystem::path&);
+
+static double benchmark(const char* name, LoadFunction func, const std::filesystem::path& path, size_t fileSize, size_t runs, TriMesh& mesh)
+{
+    std::vector<double> timings;
+    for (size_t i = 0; i < runs; ++i) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        mesh             = func(path);
+        timings.push_back(std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+
+    std::sort(timings.begin(), timings.end());
+    const double median = timings[timings.size() / 2];
+    const double mbs    = fileSize / (1024.0 * 1024.0) / median;
+    std::cout << name << ": " << median * 1000 << "ms (median), " << mbs << " MB/s" << std::endl;
+    return mbs;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2 && argc != 3) {
+        std::cout << "Expected objbench INPUT (RUNS)" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const std::filesystem::path input = argv[1];
+    const size_t runs                 = argc == 3 ? std::max<size_t>(1, strtoul(argv[2], nullptr, 10)) : 3;
+
+    std::error_code ec;
+    const size_t fileSize = std::filesystem::file_size(input, ec);
+    if (ec) {
+        std::cerr << "Could not access " << input << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    IG_LOGGER.setQuiet(true);
+
+    TriMesh seqMesh;
+    TriMesh parMesh;
+    const double seq = benchmark("Sequential", obj::loadSequential, input, fileSize, runs, seqMesh);
+    const double par = benchmark("Parallel  ", obj::loadParallel, input, fileSize, runs, parMesh);
+    std::cout << "Speedup: " << par / seq << "x" << std::endl;
+
+    if (seqMesh.vertices != parMesh.vertices || seqMesh.indices != parMesh.indices
+        || seqMesh.normals != parMesh.normals || seqMesh.texcoords != parMesh.texcoords) {
+        std::cerr << "Meshes do not match! Note: Polygons with more than three vertices might be triangulated differently" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}